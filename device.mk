@@ -212,6 +212,10 @@ PRODUCT_COPY_FILES += \
 PRODUCT_PACKAGES += \
     android.hardware.power.stats@1.0-service.pixel
 
+PRODUCT_COPY_FILES += \
+    device/google/wahoo/powerstats/powerstats_config.json:$(TARGET_COPY_OUT_VENDOR)/etc/powerstats_config.json \
+    device/google/wahoo/powerstats/powerstats_energy_model.json:$(TARGET_COPY_OUT_VENDOR)/etc/powerstats_energy_model.json
+
 # health HAL
 PRODUCT_PACKAGES += \
     android.hardware.health@2.0-service.wahoo
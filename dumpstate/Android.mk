@@ -21,6 +21,9 @@ LOCAL_INIT_RC := android.hardware.dumpstate@1.0-service.wahoo.rc
 LOCAL_MODULE_RELATIVE_PATH := hw
 
 LOCAL_SRC_FILES := \
+    DumpCollectors.cpp \
+    DumpLogCopier.cpp \
+    DumpSectionRunner.cpp \
     DumpstateDevice.cpp \
     service.cpp
 
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpCollectors.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace V1_0 {
+namespace implementation {
+
+using android::base::StringAppendF;
+using android::base::unique_fd;
+
+/*
+ * Output of one collector run, with the file buffer shared by every read.
+ * Paths follow the shell loops: |dir| is opened once and the files below it
+ * are read relative to it.
+ */
+class Collection {
+  public:
+    Collection() : mBuf(16384) {}
+
+    std::string &out() { return mOut; }
+
+    // Sorted names in |path| starting with |prefix|, without hidden files,
+    // like the shell expands "path/prefix*".
+    static std::vector<std::string> list(const std::string &path, const char *prefix = "") {
+        std::vector<std::string> names;
+        DIR *dir = opendir(path.c_str());
+        if (!dir) {
+            return names;
+        }
+        size_t len = strlen(prefix);
+        while (struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] != '.' && !strncmp(entry->d_name, prefix, len)) {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    static bool isDir(int dirfd, const std::string &name) {
+        struct stat st;
+        return !fstatat(dirfd, name.c_str(), &st, 0) && S_ISDIR(st.st_mode);
+    }
+
+    static bool isFile(int dirfd, const std::string &name) {
+        struct stat st;
+        return !fstatat(dirfd, name.c_str(), &st, 0) && S_ISREG(st.st_mode);
+    }
+
+    // Appends the file like cat; nothing if it cannot be read.
+    void cat(int dirfd, const std::string &name) {
+        size_t len = read(dirfd, name);
+        mOut.append(mBuf.data(), len);
+    }
+
+    // Appends the file like `cat` in a command substitution, which drops the
+    // trailing newlines.
+    void catTrimmed(int dirfd, const std::string &name) {
+        size_t len = read(dirfd, name);
+        while (len > 0 && mBuf[len - 1] == '\n') {
+            len--;
+        }
+        mOut.append(mBuf.data(), len);
+    }
+
+  private:
+    // Reads the whole file into mBuf and returns its length.
+    size_t read(int dirfd, const std::string &name) {
+        unique_fd fd(TEMP_FAILURE_RETRY(openat(dirfd, name.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (fd < 0) {
+            return 0;
+        }
+        size_t len = 0;
+        while (true) {
+            if (len == mBuf.size()) {
+                mBuf.resize(mBuf.size() * 2);
+            }
+            ssize_t n = TEMP_FAILURE_RETRY(::read(fd, mBuf.data() + len, mBuf.size() - len));
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+        }
+        return len;
+    }
+
+    std::vector<char> mBuf;
+    std::string mOut;
+};
+
+static unique_fd openDir(const std::string &path) {
+    return unique_fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+}
+
+// for f in /sys/class/thermal/<prefix>* ; do echo "`cat $f/type`: `cat $f/<file>`" ; done
+static void collectThermal(Collection *c, const char *prefix, const char *file) {
+    static const char kThermalDir[] = "/sys/class/thermal";
+    unique_fd dir = openDir(kThermalDir);
+    for (const auto &name : Collection::list(kThermalDir, prefix)) {
+        c->catTrimmed(dir, name + "/type");
+        c->out() += ": ";
+        c->catTrimmed(dir, name + "/" + file);
+        c->out() += "\n";
+    }
+}
+
+static void collectTemperatures(Collection *c) {
+    collectThermal(c, "thermal", "temp");
+}
+
+static void collectCoolingDevices(Collection *c) {
+    collectThermal(c, "cooling", "cur_state");
+}
+
+static const char kCpuDir[] = "/sys/devices/system/cpu";
+
+static void collectCpuTimeInState(Collection *c) {
+    unique_fd dir = openDir(kCpuDir);
+    for (const auto &cpu : Collection::list(kCpuDir, "cpu")) {
+        std::string name = cpu + "/cpufreq/stats/time_in_state";
+        if (!Collection::isFile(dir, name)) {
+            continue;
+        }
+        c->out() += std::string(kCpuDir) + "/" + name + ":\n";
+        c->cat(dir, name);
+    }
+}
+
+static void collectCpuIdle(Collection *c) {
+    unique_fd dir = openDir(kCpuDir);
+    for (const auto &cpu : Collection::list(kCpuDir, "cpu")) {
+        std::string cpuidle = cpu + "/cpuidle";
+        for (const auto &state : Collection::list(std::string(kCpuDir) + "/" + cpuidle, "state")) {
+            std::string d = cpuidle + "/" + state;
+            if (!Collection::isDir(dir, d)) {
+                continue;
+            }
+            c->out() += std::string(kCpuDir) + "/" + d + ": ";
+            c->catTrimmed(dir, d + "/name");
+            c->out() += " ";
+            c->catTrimmed(dir, d + "/desc");
+            c->out() += " ";
+            c->catTrimmed(dir, d + "/time");
+            c->out() += " ";
+            c->catTrimmed(dir, d + "/usage");
+            c->out() += "\n";
+        }
+    }
+}
+
+static void collectPowerSupply(Collection *c) {
+    static const char kPowerSupplyDir[] = "/sys/class/power_supply";
+    unique_fd dir = openDir(kPowerSupplyDir);
+    for (const auto &supply : Collection::list(kPowerSupplyDir)) {
+        std::string name = supply + "/uevent";
+        if (faccessat(dir, name.c_str(), F_OK, 0)) {
+            continue;
+        }
+        c->out() += std::string("\n------ ") + kPowerSupplyDir + "/" + name + "\n";
+        c->cat(dir, name);
+    }
+}
+
+static void collectIonHeaps(Collection *c) {
+    static const char kIonDir[] = "/d/ion";
+    unique_fd dir = openDir(kIonDir);
+    for (const auto &d : Collection::list(kIonDir)) {
+        if (!Collection::isDir(dir, d)) {
+            continue;
+        }
+        for (const auto &f : Collection::list(std::string(kIonDir) + "/" + d)) {
+            std::string name = d + "/" + f;
+            c->out() += std::string("--- ") + kIonDir + "/" + name + "\n";
+            c->cat(dir, name);
+        }
+    }
+}
+
+static void collectIpcLogs(Collection *c) {
+    static const char kIpcLoggingDir[] = "/d/ipc_logging";
+    static const char kSuffix[] = "_IPCRTR";
+    unique_fd dir = openDir(kIpcLoggingDir);
+    for (const auto &d : Collection::list(kIpcLoggingDir)) {
+        if (d.size() < strlen(kSuffix) ||
+                d.compare(d.size() - strlen(kSuffix), std::string::npos, kSuffix)) {
+            continue;
+        }
+        std::string name = d + "/log";
+        if (faccessat(dir, name.c_str(), F_OK, 0)) {
+            continue;
+        }
+        c->out() += std::string("------ ") + kIpcLoggingDir + "/" + name + "\n";
+        c->catTrimmed(dir, name);
+        c->out() += "\n\n";
+    }
+}
+
+static void collectEasel(Collection *c) {
+    static const char kEaselI2cDir[] = "/sys/bus/i2c/devices/9-0008";
+    static const char kEaselStatePath[] = "/sys/devices/virtual/misc/mnh_sm/state";
+    unique_fd dir = openDir(kEaselI2cDir);
+    for (const auto &name : Collection::list(kEaselI2cDir)) {
+        bool curr = name.size() >= 4 && !name.compare(name.size() - 4, 4, "curr");
+        if (!curr && name != "temperature" && name != "vbat" && name != "total_power") {
+            continue;
+        }
+        c->out() += std::string(kEaselI2cDir) + "/" + name + ": ";
+        c->catTrimmed(dir, name);
+        c->out() += "\n";
+    }
+    c->out() += std::string(kEaselStatePath) + ": ";
+    c->catTrimmed(AT_FDCWD, kEaselStatePath);
+    c->out() += "\n";
+}
+
+struct CollectorInfo {
+    Collector collector;
+    const char *title;
+    void (*collect)(Collection *c);
+    // The shell loop the collector replaced. It is still named in the
+    // section header, so the bugreport reads as it did with the shell.
+    const char *shell;
+};
+
+static const CollectorInfo kCollectors[] = {
+    {Collector::TEMPERATURES, "Temperatures", collectTemperatures,
+     "for f in /sys/class/thermal/thermal* ; do type=`cat $f/type` ; temp=`cat $f/temp` ; echo \"$type: $temp\" ; done"},
+    {Collector::COOLING_DEVICES, "Cooling Device Current State", collectCoolingDevices,
+     "for f in /sys/class/thermal/cooling* ; do type=`cat $f/type` ; temp=`cat $f/cur_state` ; echo \"$type: $temp\" ; done"},
+    {Collector::CPU_TIME_IN_STATE, "CPU time-in-state", collectCpuTimeInState,
+     "for cpu in /sys/devices/system/cpu/cpu*; do f=$cpu/cpufreq/stats/time_in_state; if [ ! -f $f ]; then continue; fi; echo $f:; cat $f; done"},
+    {Collector::CPU_IDLE, "CPU cpuidle", collectCpuIdle,
+     "for cpu in /sys/devices/system/cpu/cpu*; do for d in $cpu/cpuidle/state*; do if [ ! -d $d ]; then continue; fi; echo \"$d: `cat $d/name` `cat $d/desc` `cat $d/time` `cat $d/usage`\"; done; done"},
+    {Collector::POWER_SUPPLY, "Power supply properties", collectPowerSupply,
+     "for f in /sys/class/power_supply/*/uevent ; do echo \"\n------ $f\" ; cat $f ; done"},
+    {Collector::ION_HEAPS, "ION HEAPS", collectIonHeaps,
+     "for d in $(ls -d /d/ion/*); do for f in $(ls $d); do echo --- $d/$f; cat $d/$f; done; done"},
+    {Collector::IPC_LOGS, "ipc-logs", collectIpcLogs,
+     "for f in `ls /d/ipc_logging/*_IPCRTR/log` ; do echo \"------ $f\\n`cat $f`\\n\" ; done"},
+    {Collector::EASEL, "Easel debug info", collectEasel,
+     "for f in `ls /sys/bus/i2c/devices/9-0008/@(*curr|temperature|vbat|total_power)`; do echo \"$f: `cat $f`\" ; done; file=/sys/devices/virtual/misc/mnh_sm/state; echo \"$file: `cat $file`\""},
+};
+
+static const CollectorInfo &info(Collector collector) {
+    for (const auto &info : kCollectors) {
+        if (info.collector == collector) {
+            return info;
+        }
+    }
+    LOG_ALWAYS_FATAL("Unknown collector %d", static_cast<int>(collector));
+}
+
+// Framed like runCommand() frames the shell loop: the same header and
+// duration trailer around the body.
+static void runCollector(int fd, const CollectorInfo &info) {
+    auto start = std::chrono::steady_clock::now();
+    Collection c;
+    c.out() = android::base::StringPrintf("------ %s (/vendor/bin/sh -c %s) ------\n",
+                                          info.title, info.shell);
+    info.collect(&c);
+    StringAppendF(&c.out(), "------ %.3fs was the duration of '%s' ------\n",
+                  std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                  info.title);
+    android::base::WriteStringToFd(c.out(), fd);
+}
+
+// Lines of |text|, without a trailing empty line.
+static std::vector<std::string> splitLines(const std::string &text) {
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        lines.push_back(text.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return lines;
+}
+
+void AddCollector(DumpSectionRunner &runner, Collector collector) {
+    const CollectorInfo &i = info(collector);
+    runner.add(i.title, [&i](int fd) { runCollector(fd, i); });
+}
+
+void CompareCollectors(int fd) {
+    std::string out = "------ Native collector comparison ------\n";
+
+    for (const auto &info : kCollectors) {
+        auto start = std::chrono::steady_clock::now();
+        Collection c;
+        info.collect(&c);
+        auto nativeTime = std::chrono::steady_clock::now() - start;
+
+        unique_fd buffer(DumpSectionRunner::createBuffer(info.title));
+        if (buffer < 0) {
+            StringAppendF(&out, "%s: no buffer for the shell output\n", info.title);
+            continue;
+        }
+        start = std::chrono::steady_clock::now();
+        DumpSectionRunner::runCommand(buffer, info.title, {"/vendor/bin/sh", "-c", info.shell}, 10);
+        auto shellTime = std::chrono::steady_clock::now() - start;
+        std::string shell;
+        lseek(buffer, 0, SEEK_SET);
+        android::base::ReadFdToString(buffer, &shell);
+
+        // Only compare the bodies; the shell command may span several header
+        // lines, so drop the header by its exact text.
+        std::string header = android::base::StringPrintf(
+                "------ %s (/vendor/bin/sh -c %s) ------\n", info.title, info.shell);
+        if (!shell.compare(0, header.size(), header)) {
+            shell.erase(0, header.size());
+        }
+        std::vector<std::string> nativeLines = splitLines(c.out());
+        std::vector<std::string> shellLines = splitLines(shell);
+        if (!shellLines.empty() &&
+                shellLines.back().find("was the duration of") != std::string::npos) {
+            shellLines.pop_back();
+        }
+        StringAppendF(&out, "%s: native %.3fs, shell %.3fs, ", info.title,
+                      std::chrono::duration<double>(nativeTime).count(),
+                      std::chrono::duration<double>(shellTime).count());
+        auto diff = std::mismatch(nativeLines.begin(), nativeLines.end(), shellLines.begin(),
+                                  shellLines.end());
+        if (diff.first == nativeLines.end() && diff.second == shellLines.end()) {
+            StringAppendF(&out, "%zu lines match\n", nativeLines.size());
+            continue;
+        }
+        StringAppendF(&out, "differ at line %zu\n",
+                      static_cast<size_t>(diff.first - nativeLines.begin()) + 1);
+        StringAppendF(&out, "  native: %s\n",
+                      diff.first == nativeLines.end() ? "<end>" : diff.first->c_str());
+        StringAppendF(&out, "  shell:  %s\n",
+                      diff.second == shellLines.end() ? "<end>" : diff.second->c_str());
+    }
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPCOLLECTORS_H
+#define ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPCOLLECTORS_H
+
+#include "DumpSectionRunner.h"
+
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Native replacements for the dumpstateBoard sections that used to fork a
+ * shell to walk a directory and cat every file in it. Each collector
+ * produces the same section as its shell loop, header and duration trailer
+ * included, reading through openat() and a buffer reused for every file,
+ * without spawning any process.
+ */
+enum class Collector {
+    TEMPERATURES,
+    COOLING_DEVICES,
+    CPU_TIME_IN_STATE,
+    CPU_IDLE,
+    POWER_SUPPLY,
+    ION_HEAPS,
+    IPC_LOGS,
+    EASEL,
+};
+
+// Adds |collector| to |runner| under the title of the section it replaces.
+void AddCollector(DumpSectionRunner &runner, Collector collector);
+
+// Runs every collector and the shell loop it replaced, and reports the time
+// each took and the first line where their output differs.
+void CompareCollectors(int fd);
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPCOLLECTORS_H
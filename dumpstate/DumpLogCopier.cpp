@@ -0,0 +1,184 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpLogCopier.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace V1_0 {
+namespace implementation {
+
+using android::base::unique_fd;
+using Deadline = std::chrono::steady_clock::time_point;
+
+// Largest single request; keeps each call short so progress is steady.
+static const size_t kCopyChunk = 16 * 1024 * 1024;
+
+// Not every libc wraps copy_file_range yet.
+static ssize_t CopyFileRange(int in, int out, size_t len) {
+#ifdef __NR_copy_file_range
+    return syscall(__NR_copy_file_range, in, nullptr, out, nullptr, len, 0);
+#else
+    (void)in;
+    (void)out;
+    (void)len;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Errors that mean the method is unavailable for this pair of files, so the
+// next one should be tried, rather than that the copy failed.
+static bool Unsupported(int error) {
+    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP;
+}
+
+static bool Expired(const Deadline &deadline) {
+    if (std::chrono::steady_clock::now() < deadline) {
+        return false;
+    }
+    errno = ETIMEDOUT;
+    return true;
+}
+
+// Copies |in| from its current offset to |out|, checking |deadline| between
+// chunks. Returns false with errno set, ETIMEDOUT if the deadline passed.
+static bool CopyFd(int in, int out, const Deadline &deadline) {
+    ssize_t n;
+
+    while ((n = TEMP_FAILURE_RETRY(CopyFileRange(in, out, kCopyChunk))) > 0) {
+        if (Expired(deadline)) {
+            return false;
+        }
+    }
+    if (n == 0) {
+        return true;
+    }
+    if (!Unsupported(errno)) {
+        return false;
+    }
+
+    while ((n = TEMP_FAILURE_RETRY(sendfile(out, in, nullptr, kCopyChunk))) > 0) {
+        if (Expired(deadline)) {
+            return false;
+        }
+    }
+    if (n == 0) {
+        return true;
+    }
+    if (!Unsupported(errno)) {
+        return false;
+    }
+
+    char buf[65536];
+    while ((n = TEMP_FAILURE_RETRY(read(in, buf, sizeof(buf)))) > 0) {
+        if (!android::base::WriteFully(out, buf, n) || Expired(deadline)) {
+            return false;
+        }
+    }
+    return n == 0;
+}
+
+// Copies |copy| like cp: a directory destination receives the source's name,
+// and the new file gets the source's permission bits. Returns an error
+// message, or an empty string on success.
+static std::string CopyLogFile(const LogCopy &copy, const Deadline &deadline) {
+    unique_fd in(TEMP_FAILURE_RETRY(open(copy.src.c_str(), O_RDONLY | O_CLOEXEC)));
+    struct stat st;
+    if (in < 0 || fstat(in, &st)) {
+        return copy.src + ": " + strerror(errno);
+    }
+
+    std::string dst = copy.dst;
+    struct stat dstSt;
+    if (!stat(dst.c_str(), &dstSt) && S_ISDIR(dstSt.st_mode)) {
+        dst += "/" + android::base::Basename(copy.src);
+    }
+    unique_fd out(TEMP_FAILURE_RETRY(open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                          st.st_mode & 0777)));
+    if (out < 0) {
+        return dst + ": " + strerror(errno);
+    }
+
+    if (!CopyFd(in, out, deadline)) {
+        if (errno == ETIMEDOUT) {
+            return copy.src + " -> " + dst + ": deadline reached, copy is incomplete";
+        }
+        return copy.src + " -> " + dst + ": " + strerror(errno);
+    }
+    return "";
+}
+
+void CopyLogFiles(int fd, const std::string &title, const std::vector<LogCopy> &copies,
+                  size_t threads, int timeoutSec) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> errors(copies.size());
+    std::atomic<size_t> next(0);
+
+    auto worker = [&] {
+        for (size_t i; (i = next++) < copies.size();) {
+            Deadline deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSec);
+            ALOGD("Copying %s to %s\n", copies[i].src.c_str(), copies[i].dst.c_str());
+            errors[i] = CopyLogFile(copies[i], deadline);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < std::min(threads, copies.size()); i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    std::string out = android::base::StringPrintf("------ %s (%zu files) ------\n", title.c_str(),
+                                                  copies.size());
+    for (const auto &error : errors) {
+        if (!error.empty()) {
+            out += "*** " + error + "\n";
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+    android::base::StringAppendF(&out, "------ %.3fs was the duration of '%s' ------\n",
+                                 elapsed.count() / 1000.0, title.c_str());
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPLOGCOPIER_H
+#define ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPLOGCOPIER_H
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace V1_0 {
+namespace implementation {
+
+struct LogCopy {
+    std::string src;
+    std::string dst;
+};
+
+/*
+ * Copies modem logs in-process instead of running a shell and cp for every
+ * file. Data moves in the kernel with copy_file_range(), falling back to
+ * sendfile() where that is not supported (older kernels, or source and
+ * destination on different filesystems), and to read/write as a last
+ * resort.
+ *
+ * Up to |threads| files are copied at once. The copies are reported to |fd|
+ * as one section under |title|, listing only the files that failed. Like
+ * each cp command this replaces, each file gets |timeoutSec|: the deadline
+ * is checked between chunks, and a copy still running at its deadline is
+ * cut short and reported. A single copy_file_range(), sendfile() or read()
+ * call that stalls is not interrupted, so a hung source still holds its
+ * worker.
+ */
+void CopyLogFiles(int fd, const std::string &title, const std::vector<LogCopy> &copies,
+                  size_t threads, int timeoutSec = 120);
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPLOGCOPIER_H
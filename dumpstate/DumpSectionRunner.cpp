@@ -0,0 +1,254 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpSectionRunner.h"
+
+#include <android-base/file.h>
+#include <fcntl.h>
+#include <linux/memfd.h>
+#include <log/log.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "DumpstateUtil.h"
+
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace V1_0 {
+namespace implementation {
+
+using android::os::dumpstate::DumpFileToFd;
+
+// Not every libc wraps memfd_create yet.
+int DumpSectionRunner::createBuffer(const std::string &name) {
+    return syscall(__NR_memfd_create, name.c_str(), MFD_CLOEXEC);
+}
+
+// The child is reaped with waitpid() on its own pid only, polling while the
+// timeout runs, so any number of these can run at once.
+void DumpSectionRunner::runCommand(int fd, const std::string &title,
+                                   const std::vector<std::string> &command, int timeoutSec) {
+    std::string header = "------ " + title + " (";
+    std::vector<char *> argv;
+    for (const auto &arg : command) {
+        header += (argv.empty() ? "" : " ") + arg;
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    android::base::WriteStringToFd(header + ") ------\n", fd);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        dprintf(fd, "*** fork: %s\n", strerror(errno));
+        return;
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDIN_FILENO);
+        }
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    auto deadline = start + std::chrono::seconds(timeoutSec);
+    auto delay = std::chrono::milliseconds(1);
+    int status;
+    pid_t ret;
+    while ((ret = TEMP_FAILURE_RETRY(waitpid(pid, &status, WNOHANG))) == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            dprintf(fd, "*** command '%s' timed out after %ds (killing pid %d)\n",
+                    title.c_str(), timeoutSec, pid);
+            kill(pid, SIGKILL);
+            TEMP_FAILURE_RETRY(waitpid(pid, &status, 0));
+            return;
+        }
+        std::this_thread::sleep_for(delay);
+        delay = std::min(delay * 2, std::chrono::milliseconds(50));
+    }
+    if (ret < 0) {
+        dprintf(fd, "*** waitpid: %s\n", strerror(errno));
+        return;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+    if (WIFSIGNALED(status)) {
+        dprintf(fd, "*** command '%s' failed: killed by signal %d\n", title.c_str(),
+                WTERMSIG(status));
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+        dprintf(fd, "*** command '%s' failed: exit code %d\n", title.c_str(),
+                WEXITSTATUS(status));
+    }
+    dprintf(fd, "------ %.3fs was the duration of '%s' ------\n", elapsed.count() / 1000.0,
+            title.c_str());
+}
+
+DumpSectionRunner::DumpSectionRunner(size_t workers, int timeoutSec)
+    : mWorkers(workers), mTimeout(timeoutSec) {}
+
+void DumpSectionRunner::add(const std::string &name, Section section) {
+    mEntries.push_back(std::make_shared<Entry>(
+            Entry{name, std::move(section), android::base::unique_fd(), false}));
+}
+
+void DumpSectionRunner::addFile(const std::string &title, const std::string &path) {
+    add(title, [title, path](int fd) { DumpFileToFd(fd, title, path); });
+}
+
+void DumpSectionRunner::addCommand(const std::string &title,
+                                   const std::vector<std::string> &command, int timeoutSec) {
+    add(title, [title, command, timeoutSec](int fd) {
+        runCommand(fd, title, command, timeoutSec);
+    });
+}
+
+void DumpSectionRunner::run(int fd) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto &entry : mEntries) {
+        entry->buffer.reset(createBuffer(entry->name));
+        if (entry->buffer < 0) {
+            ALOGE("Failed to create buffer for %s: %s\n", entry->name.c_str(), strerror(errno));
+        }
+    }
+
+    auto queue = std::make_shared<Queue>();
+    queue->entries = mEntries;
+    queue->next = 0;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(mWorkers, mEntries.size()); i++) {
+        threads.emplace_back(&DumpSectionRunner::workerLoop, queue);
+    }
+
+    size_t abandoned = 0;
+    for (auto &entry : mEntries) {
+        if (entry->buffer < 0) {
+            entry->section(fd);
+            continue;
+        }
+        bool done;
+        {
+            std::unique_lock<std::mutex> lock(queue->lock);
+            done = queue->done.wait_for(lock, mTimeout, [&entry] { return entry->done; });
+        }
+        copyBuffer(fd, *entry);
+        if (!done) {
+            dprintf(fd, "*** section '%s' timed out after %llds, output is incomplete\n",
+                    entry->name.c_str(), static_cast<long long>(mTimeout.count()));
+            ALOGE("Section %s timed out\n", entry->name.c_str());
+            // The worker stays stuck in this section; keep the pool size.
+            abandoned++;
+            threads.emplace_back(&DumpSectionRunner::workerLoop, queue);
+        }
+    }
+
+    // The workers exit once the queue is empty, except those still stuck in
+    // an abandoned section; they hold their own references to the queue.
+    for (auto &thread : threads) {
+        if (abandoned) {
+            thread.detach();
+        } else {
+            thread.join();
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+    ALOGD("Ran %zu sections on %zu workers in %lld ms, %zu timed out\n", mEntries.size(),
+          threads.size(), static_cast<long long>(elapsed.count()), abandoned);
+    mEntries.clear();
+}
+
+void DumpSectionRunner::workerLoop(std::shared_ptr<Queue> queue) {
+    while (true) {
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(queue->lock);
+            while (queue->next < queue->entries.size() &&
+                    queue->entries[queue->next]->buffer < 0) {
+                queue->next++;
+            }
+            if (queue->next == queue->entries.size()) {
+                return;
+            }
+            entry = queue->entries[queue->next++];
+        }
+
+        entry->section(entry->buffer);
+
+        {
+            std::lock_guard<std::mutex> lock(queue->lock);
+            entry->done = true;
+        }
+        queue->done.notify_all();
+    }
+}
+
+void DumpSectionRunner::copyBuffer(int fd, const Entry &entry) {
+    off_t size = lseek(entry.buffer, 0, SEEK_END);
+    off_t offset = 0;
+
+    while (offset < size) {
+        ssize_t sent = sendfile(fd, entry.buffer, &offset, size - offset);
+        if (sent > 0) {
+            continue;
+        }
+        if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            break;
+        }
+        ALOGE("Failed to write %s: %s\n", entry.name.c_str(), strerror(errno));
+        return;
+    }
+
+    // sendfile() does not support every output fd; copy the rest by hand.
+    char buf[65536];
+    while (offset < size) {
+        ssize_t n = TEMP_FAILURE_RETRY(pread(entry.buffer, buf, sizeof(buf), offset));
+        if (n <= 0) {
+            ALOGE("Failed to read %s: %s\n", entry.name.c_str(), strerror(errno));
+            return;
+        }
+        for (ssize_t written = 0; written < n;) {
+            ssize_t w = TEMP_FAILURE_RETRY(write(fd, buf + written, n - written));
+            if (w <= 0) {
+                ALOGE("Failed to write %s: %s\n", entry.name.c_str(), strerror(errno));
+                return;
+            }
+            written += w;
+        }
+        offset += n;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPSECTIONRUNNER_H
+#define ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPSECTIONRUNNER_H
+
+#include <android-base/unique_fd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Runs independent dump sections on a pool of worker threads, each into its
+ * own memfd, and writes their output to the bugreport fd in the order they
+ * were added. Output is streamed as soon as the next section in order is
+ * done, so the total time is bounded by the slowest section rather than the
+ * sum of all of them.
+ *
+ * A section that cannot get a buffer runs on the calling thread directly
+ * into the output fd when its turn comes.
+ *
+ * A section still running |timeoutSec| after its turn came is abandoned:
+ * whatever it wrote so far is copied, followed by a "*** ... timed out"
+ * line, and a new worker replaces the stuck one. The stuck worker keeps
+ * its entry and buffer alive and is left to finish on its own.
+ *
+ * RunCommandToFd() waits for its child with sigtimedwait(SIGCHLD), which
+ * can pick up another thread's child, so sections must not call it; use
+ * addCommand() instead.
+ */
+class DumpSectionRunner {
+  public:
+    using Section = std::function<void(int fd)>;
+
+    explicit DumpSectionRunner(size_t workers, int timeoutSec = 30);
+    void add(const std::string &name, Section section);
+    // A section made of a single DumpFileToFd().
+    void addFile(const std::string &title, const std::string &path);
+    // A section running |command|, killed after |timeoutSec|.
+    void addCommand(const std::string &title, const std::vector<std::string> &command,
+                    int timeoutSec = 10);
+    // Runs all added sections and writes their output to |fd|.
+    void run(int fd);
+
+    // Anonymous in-memory file for section output, or -1.
+    static int createBuffer(const std::string &name);
+    // Runs |command| with its output going to |fd|, in the format of
+    // RunCommandToFd(), and kills it after |timeoutSec|.
+    static void runCommand(int fd, const std::string &title,
+                           const std::vector<std::string> &command, int timeoutSec);
+
+  private:
+    struct Entry {
+        std::string name;
+        Section section;
+        android::base::unique_fd buffer;
+        bool done;
+    };
+    // Shared with the workers, which outlive run() if a section hangs.
+    struct Queue {
+        std::mutex lock;
+        std::condition_variable done;
+        std::vector<std::shared_ptr<Entry>> entries;
+        size_t next;  // next entry for a worker to pick up, guarded by lock
+    };
+
+    static void workerLoop(std::shared_ptr<Queue> queue);
+    static void copyBuffer(int fd, const Entry &entry);
+
+    const size_t mWorkers;
+    const std::chrono::seconds mTimeout;
+    std::vector<std::shared_ptr<Entry>> mEntries;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_DUMPSTATE_V1_0_DUMPSECTIONRUNNER_H
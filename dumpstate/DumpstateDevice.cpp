@@ -29,6 +29,9 @@
 #define _SVID_SOURCE
 #include <dirent.h>
 
+#include "DumpCollectors.h"
+#include "DumpLogCopier.h"
+#include "DumpSectionRunner.h"
 #include "DumpstateUtil.h"
 
 #define MODEM_LOG_PREFIX_PROPERTY "ro.radio.log_prefix"
@@ -41,6 +44,16 @@
 
 #define DIAG_MDLOG_NUMBER_BUGREPORT "persist.sys.modem.diag.mdlog_br_num"
 
+// Modem log files copied at once.
+#define LOG_COPY_THREADS_PROPERTY "persist.vendor.dumpstate.log_copy_threads"
+
+// Most sections block on slow kernel nodes rather than the CPU.
+#define DUMP_SECTION_WORKERS 8
+
+// Also run the shell loops the native collectors replaced, and report any
+// difference in their output.
+#define DUMP_COMPARE_COLLECTORS_PROPERTY "persist.vendor.dumpstate.compare_collectors"
+
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
 using android::os::dumpstate::PropertiesHelper;
@@ -54,6 +67,11 @@ namespace implementation {
 
 #define DIAG_LOG_PREFIX "diag_log_"
 
+static size_t LogCopyThreads() {
+    size_t threads = android::base::GetUintProperty<size_t>(LOG_COPY_THREADS_PROPERTY, 2, 8);
+    return std::max<size_t>(threads, 1);
+}
+
 void DumpstateDevice::dumpDiagLogs(int fd, std::string srcDir, std::string destDir) {
     struct dirent **dirent_list = NULL;
     int num_entries = scandir(srcDir.c_str(),
@@ -68,6 +86,7 @@ void DumpstateDevice::dumpDiagLogs(int fd, std::string srcDir, std::string destD
 
     int maxFileNum = android::base::GetIntProperty(DIAG_MDLOG_NUMBER_BUGREPORT, 100);
     int copiedFiles = 0;
+    std::vector<LogCopy> copies;
 
     for (int i = num_entries - 1; i >= 0; i--) {
         ALOGD("Found %s\n", dirent_list[i]->d_name);
@@ -83,16 +102,12 @@ void DumpstateDevice::dumpDiagLogs(int fd, std::string srcDir, std::string destD
 
         copiedFiles++;
 
-        CommandOptions options = CommandOptions::WithTimeout(120).Build();
-        std::string srcLogFile = srcDir + "/" + dirent_list[i]->d_name;
-        std::string destLogFile = destDir + "/" + dirent_list[i]->d_name;
-
-        std::string copyCmd= "/vendor/bin/cp " + srcLogFile + " " + destLogFile;
-
-        ALOGD("Copying %s to %s\n", srcLogFile.c_str(), destLogFile.c_str());
-        RunCommandToFd(fd, "CP DIAG LOGS", { "/vendor/bin/sh", "-c", copyCmd.c_str() }, options);
+        copies.push_back({srcDir + "/" + dirent_list[i]->d_name,
+                          destDir + "/" + dirent_list[i]->d_name});
     }
 
+    CopyLogFiles(fd, "CP DIAG LOGS", copies, LogCopyThreads());
+
     while (num_entries--) {
         free(dirent_list[num_entries]);
     }
@@ -167,11 +182,12 @@ void DumpstateDevice::dumpModem(int fd, int fdModem)
             }
         }
 
+        std::vector<LogCopy> copies;
         for (const auto& logFile : rilAndNetmgrLogs)
         {
-            std::string copyCmd= "/vendor/bin/cp " + logFile + " " + modemLogAllDir;
-            RunCommandToFd(fd, "CP MODEM LOG", { "/vendor/bin/sh", "-c", copyCmd.c_str() }, options);
+            copies.push_back({logFile, modemLogAllDir});
         }
+        CopyLogFiles(fd, "CP MODEM LOG", copies, LogCopyThreads());
 
         std::string filePrefix = android::base::GetProperty(MODEM_LOG_PREFIX_PROPERTY, "");
 
@@ -213,13 +229,13 @@ void DumpstateDevice::dumpModem(int fd, int fdModem)
     }
 }
 
-static void DumpPower(int fd) {
-    RunCommandToFd(fd, "Power Stats Times", {"/vendor/bin/sh", "-c",
-                   "echo -n \"Boot: \" && /vendor/bin/uptime -s &&"
-                   "echo -n \"Now: \" && date"});
-    DumpFileToFd(fd, "RPM Stats", "/d/rpm_stats");
-    DumpFileToFd(fd, "Power Management Stats", "/d/rpm_master_stats");
-    DumpFileToFd(fd, "WLAN Power Stats", "/d/wlan0/power_stats");
+static void DumpPower(DumpSectionRunner &runner) {
+    runner.addCommand("Power Stats Times", {"/vendor/bin/sh", "-c",
+                      "echo -n \"Boot: \" && /vendor/bin/uptime -s &&"
+                      "echo -n \"Now: \" && date"});
+    runner.addFile("RPM Stats", "/d/rpm_stats");
+    runner.addFile("Power Management Stats", "/d/rpm_master_stats");
+    runner.addFile("WLAN Power Stats", "/d/wlan0/power_stats");
 }
 
 static void DumpTouch(int fd) {
@@ -262,49 +278,56 @@ Return<void> DumpstateDevice::dumpstateBoard(const hidl_handle& handle) {
         int fdModem = handle->data[1];
         dumpModem(fd, fdModem);
     }
-    RunCommandToFd(fd, "VENDOR PROPERTIES", {"/vendor/bin/getprop"});
-    DumpFileToFd(fd, "SoC serial number", "/sys/devices/soc0/serial_number");
-    DumpFileToFd(fd, "CPU present", "/sys/devices/system/cpu/present");
-    DumpFileToFd(fd, "CPU online", "/sys/devices/system/cpu/online");
-    DumpFileToFd(fd, "UFS model", "/sys/block/sda/device/model");
-    DumpFileToFd(fd, "UFS rev", "/sys/block/sda/device/rev");
-    DumpFileToFd(fd, "UFS size", "/sys/block/sda/size");
-    RunCommandToFd(fd, "UFS health", {"/vendor/bin/sh", "-c", "for f in $(find /sys/kernel/debug/ufshcd0 -type f); do if [[ -r $f && -f $f ]]; then echo --- $f; cat $f; fi; done"});
-    DumpFileToFd(fd, "INTERRUPTS", "/proc/interrupts");
-
-    DumpPower(fd);
-
-    DumpFileToFd(fd, "LL-Stats", "/d/wlan0/ll_stats");
-    DumpFileToFd(fd, "ICNSS Stats", "/d/icnss/stats");
-    DumpFileToFd(fd, "SMD Log", "/d/ipc_logging/smd/log");
-    RunCommandToFd(fd, "ION HEAPS", {"/vendor/bin/sh", "-c", "for d in $(ls -d /d/ion/*); do for f in $(ls $d); do echo --- $d/$f; cat $d/$f; done; done"});
-    DumpFileToFd(fd, "dmabuf info", "/d/dma_buf/bufinfo");
-    RunCommandToFd(fd, "Easel debug info", {"/vendor/bin/sh", "-c", "for f in `ls /sys/bus/i2c/devices/9-0008/@(*curr|temperature|vbat|total_power)`; do echo \"$f: `cat $f`\" ; done; file=/sys/devices/virtual/misc/mnh_sm/state; echo \"$file: `cat $file`\""});
-    RunCommandToFd(fd, "Temperatures", {"/vendor/bin/sh", "-c", "for f in /sys/class/thermal/thermal* ; do type=`cat $f/type` ; temp=`cat $f/temp` ; echo \"$type: $temp\" ; done"});
-    RunCommandToFd(fd, "Cooling Device Current State", {"/vendor/bin/sh", "-c", "for f in /sys/class/thermal/cooling* ; do type=`cat $f/type` ; temp=`cat $f/cur_state` ; echo \"$type: $temp\" ; done"});
-    RunCommandToFd(fd, "CPU time-in-state", {"/vendor/bin/sh", "-c", "for cpu in /sys/devices/system/cpu/cpu*; do f=$cpu/cpufreq/stats/time_in_state; if [ ! -f $f ]; then continue; fi; echo $f:; cat $f; done"});
-    RunCommandToFd(fd, "CPU cpuidle", {"/vendor/bin/sh", "-c", "for cpu in /sys/devices/system/cpu/cpu*; do for d in $cpu/cpuidle/state*; do if [ ! -d $d ]; then continue; fi; echo \"$d: `cat $d/name` `cat $d/desc` `cat $d/time` `cat $d/usage`\"; done; done"});
-    DumpFileToFd(fd, "MDP xlogs", "/data/vendor/display/mdp_xlog");
-    DumpFileToFd(fd, "TCPM logs", "/d/tcpm/usbpd0");
-    DumpFileToFd(fd, "PD Engine", "/d/pd_engine/usbpd0");
-    DumpFileToFd(fd, "smblib-usb logs", "/d/ipc_logging/smblib/log");
-    DumpFileToFd(fd, "ipc-local-ports", "/d/msm_ipc_router/dump_local_ports");
-    DumpFileToFd(fd, "ipc-servers", "/d/msm_ipc_router/dump_servers");
-    RunCommandToFd(fd, "ipc-logs",
-                   {"/vendor/bin/sh", "-c",
-                    "for f in `ls /d/ipc_logging/*_IPCRTR/log` ; do echo \"------ $f\\n`cat "
-                    "$f`\\n\" ; done"});
-    DumpTouch(fd);
-    RunCommandToFd(fd, "USB Device Descriptors", {"/vendor/bin/sh", "-c", "cd /sys/bus/usb/devices/1-1 && cat product && cat bcdDevice; cat descriptors | od -t x1 -w16 -N96"});
-    DumpFileToFd(fd, "Pixel trace", "/d/tracing/instances/pixel-trace/trace");
+
+    // The sections below only read independent nodes, so they run in
+    // parallel; their output still lands in this order.
+    DumpSectionRunner runner(DUMP_SECTION_WORKERS);
+    runner.addCommand("VENDOR PROPERTIES", {"/vendor/bin/getprop"});
+    runner.addFile("SoC serial number", "/sys/devices/soc0/serial_number");
+    runner.addFile("CPU present", "/sys/devices/system/cpu/present");
+    runner.addFile("CPU online", "/sys/devices/system/cpu/online");
+    runner.addFile("UFS model", "/sys/block/sda/device/model");
+    runner.addFile("UFS rev", "/sys/block/sda/device/rev");
+    runner.addFile("UFS size", "/sys/block/sda/size");
+    runner.addCommand("UFS health", {"/vendor/bin/sh", "-c", "for f in $(find /sys/kernel/debug/ufshcd0 -type f); do if [[ -r $f && -f $f ]]; then echo --- $f; cat $f; fi; done"});
+    runner.addFile("INTERRUPTS", "/proc/interrupts");
+
+    DumpPower(runner);
+
+    runner.addFile("LL-Stats", "/d/wlan0/ll_stats");
+    runner.addFile("ICNSS Stats", "/d/icnss/stats");
+    runner.addFile("SMD Log", "/d/ipc_logging/smd/log");
+    AddCollector(runner, Collector::ION_HEAPS);
+    runner.addFile("dmabuf info", "/d/dma_buf/bufinfo");
+    AddCollector(runner, Collector::EASEL);
+    AddCollector(runner, Collector::TEMPERATURES);
+    AddCollector(runner, Collector::COOLING_DEVICES);
+    AddCollector(runner, Collector::CPU_TIME_IN_STATE);
+    AddCollector(runner, Collector::CPU_IDLE);
+    runner.addFile("MDP xlogs", "/data/vendor/display/mdp_xlog");
+    runner.addFile("TCPM logs", "/d/tcpm/usbpd0");
+    runner.addFile("PD Engine", "/d/pd_engine/usbpd0");
+    runner.addFile("smblib-usb logs", "/d/ipc_logging/smblib/log");
+    runner.addFile("ipc-local-ports", "/d/msm_ipc_router/dump_local_ports");
+    runner.addFile("ipc-servers", "/d/msm_ipc_router/dump_servers");
+    AddCollector(runner, Collector::IPC_LOGS);
+    runner.add("Touch", DumpTouch);
+    runner.addCommand("USB Device Descriptors", {"/vendor/bin/sh", "-c", "cd /sys/bus/usb/devices/1-1 && cat product && cat bcdDevice; cat descriptors | od -t x1 -w16 -N96"});
+    runner.addFile("Pixel trace", "/d/tracing/instances/pixel-trace/trace");
 
     // Timeout after 3s
-    RunCommandToFd(fd, "QSEE logs", {"/vendor/bin/sh", "-c", "/vendor/bin/timeout 3 cat /d/tzdbg/qsee_log"});
-    RunCommandToFd(fd, "Power supply properties", {"/vendor/bin/sh", "-c", "for f in /sys/class/power_supply/*/uevent ; do echo \"\n------ $f\" ; cat $f ; done"});
-    DumpFileToFd(fd, "Battery cycle count", "/sys/class/power_supply/bms/device/cycle_counts_bins");
-    RunCommandToFd(fd, "QCOM FG SRAM", {"/vendor/bin/sh", "-c", "echo 0 > /d/fg/sram/address ; echo 500 > /d/fg/sram/count ; cat /d/fg/sram/data"});
+    runner.addCommand("QSEE logs", {"/vendor/bin/sh", "-c", "/vendor/bin/timeout 3 cat /d/tzdbg/qsee_log"});
+    AddCollector(runner, Collector::POWER_SUPPLY);
+    runner.addFile("Battery cycle count", "/sys/class/power_supply/bms/device/cycle_counts_bins");
+    runner.addCommand("QCOM FG SRAM", {"/vendor/bin/sh", "-c", "echo 0 > /d/fg/sram/address ; echo 500 > /d/fg/sram/count ; cat /d/fg/sram/data"});
+
+    runner.addFile("WLAN FW Log Symbol Table", "/vendor/firmware/Data.msc");
+
+    if (android::base::GetBoolProperty(DUMP_COMPARE_COLLECTORS_PROPERTY, false)) {
+        runner.add("Native collector comparison", CompareCollectors);
+    }
 
-    DumpFileToFd(fd, "WLAN FW Log Symbol Table", "/vendor/firmware/Data.msc");
+    runner.run(fd);
 
     return Void();
 };
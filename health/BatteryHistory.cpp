@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatteryHistory.h"
+#include "HealthPaths.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr char kMagic[] = "WBH1";
+static constexpr size_t kMagicLen = sizeof(kMagic) - 1;
+static constexpr char kKeyframeTag = 'K';
+static constexpr char kDeltaTag = 'D';
+static constexpr size_t kKeyframeInterval = 32;
+// A delta record is typically 12-16 bytes, so this holds a few thousand
+// capacity or bin changes before the oldest ones get thinned out.
+static constexpr size_t kMaxFileSize = 64 * 1024;
+
+static void PutVarint(uint64_t v, std::string *out) {
+    while (v >= 0x80) {
+        out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out->push_back(static_cast<char>(v));
+}
+
+static void PutSigned(int64_t v, std::string *out) {
+    PutVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63), out);
+}
+
+static bool GetVarint(const std::string &in, size_t *pos, uint64_t *v) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *pos < in.size(); shift += 7) {
+        uint8_t b = in[(*pos)++];
+        result |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool GetSigned(const std::string &in, size_t *pos, int64_t *v) {
+    uint64_t u;
+    if (!GetVarint(in, pos, &u))
+        return false;
+    *v = static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+    return true;
+}
+
+// Encodes |rec| as a keyframe when |prev| is null, else as a delta to |prev|.
+static void EncodeRecord(const BatteryHistoryRecord *prev, const BatteryHistoryRecord &rec,
+                         std::string *out) {
+    if (!prev) {
+        out->push_back(kKeyframeTag);
+        PutSigned(static_cast<int64_t>(rec.timestamp), out);
+        PutSigned(rec.charge_full, out);
+        for (int i = 0; i < kBucketCount; i++)
+            PutSigned(rec.bins[i], out);
+        return;
+    }
+
+    out->push_back(kDeltaTag);
+    PutSigned(static_cast<int64_t>(rec.timestamp - prev->timestamp), out);
+    PutSigned(static_cast<int64_t>(rec.charge_full) - prev->charge_full, out);
+    for (int i = 0; i < kBucketCount; i++)
+        PutSigned(static_cast<int64_t>(rec.bins[i]) - prev->bins[i], out);
+}
+
+bool BatteryHistory::Decode(const std::string &data, std::vector<BatteryHistoryRecord> *records) {
+    records->clear();
+    if (data.compare(0, kMagicLen, kMagic) != 0)
+        return false;
+
+    size_t pos = kMagicLen;
+    while (pos < data.size()) {
+        char tag = data[pos++];
+        int64_t v[kBucketCount + 2];
+
+        if (tag != kKeyframeTag && tag != kDeltaTag)
+            return false;
+        if (tag == kDeltaTag && records->empty())
+            return false;
+        for (int64_t &field : v) {
+            if (!GetSigned(data, &pos, &field))
+                return false;
+        }
+        BatteryHistoryRecord rec = tag == kDeltaTag ? records->back() : BatteryHistoryRecord{};
+        rec.timestamp += v[0];
+        rec.charge_full += v[1];
+        for (int i = 0; i < kBucketCount; i++)
+            rec.bins[i] += v[i + 2];
+        records->push_back(rec);
+    }
+    return true;
+}
+
+void BatteryHistory::Encode(const std::vector<BatteryHistoryRecord> &records, std::string *data) {
+    data->assign(kMagic, kMagicLen);
+    for (size_t i = 0; i < records.size(); i++)
+        EncodeRecord(i % kKeyframeInterval ? &records[i - 1] : nullptr, records[i], data);
+}
+
+BatteryHistory::BatteryHistory(const char *path)
+    : raw_path_(path), loaded_(false), have_last_(false), last_{}, since_keyframe_(0),
+      file_size_(0) {}
+
+void BatteryHistory::Load() {
+    std::string data;
+    std::vector<BatteryHistoryRecord> records;
+
+    loaded_ = true;
+    path_ = HealthPath(raw_path_);
+    if (!android::base::ReadFileToString(path_, &data) || data.empty())
+        return;
+
+    if (!Decode(data, &records)) {
+        LOG(ERROR) << path_ << ": corrupt after " << records.size() << " records, rewriting";
+        Encode(records, &data);
+        if (!android::base::WriteStringToFile(data, path_)) {
+            PLOG(ERROR) << path_ << ": rewrite failed";
+            return;
+        }
+    }
+
+    file_size_ = data.size();
+    if (!records.empty()) {
+        have_last_ = true;
+        last_ = records.back();
+        since_keyframe_ = (records.size() - 1) % kKeyframeInterval + 1;
+    }
+}
+
+/*
+ * Keeps the newer half of the history intact and every other record of the
+ * older half, so long-term fade stays visible while the file stays bounded.
+ */
+void BatteryHistory::Compact() {
+    std::string data;
+    std::vector<BatteryHistoryRecord> records, kept;
+
+    if (!android::base::ReadFileToString(path_, &data))
+        return;
+    Decode(data, &records);
+
+    size_t half = records.size() / 2;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (i >= half || i % 2 == 0)
+            kept.push_back(records[i]);
+    }
+
+    Encode(kept, &data);
+    std::string tmp = path_ + ".tmp";
+    if (!android::base::WriteStringToFile(data, tmp) || rename(tmp.c_str(), path_.c_str())) {
+        PLOG(ERROR) << path_ << ": compaction failed";
+        unlink(tmp.c_str());
+        return;
+    }
+
+    LOG(INFO) << path_ << ": compacted " << records.size() << " records to " << kept.size();
+    file_size_ = data.size();
+    since_keyframe_ = kept.empty() ? 0 : (kept.size() - 1) % kKeyframeInterval + 1;
+}
+
+void BatteryHistory::Append(int charge_full, const int *bins) {
+    if (!loaded_)
+        Load();
+
+    // Nothing learned yet, e.g. the fuel gauge has not reported.
+    if (charge_full <= 0)
+        return;
+
+    if (have_last_ && last_.charge_full == charge_full &&
+        !memcmp(last_.bins, bins, sizeof(last_.bins)))
+        return;
+
+    BatteryHistoryRecord rec = {};
+    rec.timestamp = time(nullptr);
+    rec.charge_full = charge_full;
+    memcpy(rec.bins, bins, sizeof(rec.bins));
+
+    std::string out;
+    if (file_size_ == 0)
+        out.assign(kMagic, kMagicLen);
+    bool keyframe = !have_last_ || since_keyframe_ >= kKeyframeInterval;
+    EncodeRecord(keyframe ? nullptr : &last_, rec, &out);
+
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+        open(path_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0660)));
+    if (fd < 0 || !android::base::WriteFully(fd, out.data(), out.size())) {
+        PLOG(ERROR) << path_ << ": append failed";
+        return;
+    }
+
+    file_size_ += out.size();
+    since_keyframe_ = keyframe ? 1 : since_keyframe_ + 1;
+    last_ = rec;
+    have_last_ = true;
+
+    if (file_size_ > kMaxFileSize)
+        Compact();
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_BATTERYHISTORY_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_BATTERYHISTORY_H
+
+#include <string>
+#include <vector>
+
+#include "CycleCountBackupRestore.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+struct BatteryHistoryRecord {
+    uint64_t timestamp;  // seconds since the epoch
+    int32_t charge_full;
+    int32_t bins[kBucketCount];
+};
+
+/*
+ * Append-only history of learned capacity and cycle count bins. Records are
+ * delta and varint encoded against the previous one, with a periodic
+ * keyframe holding absolute values. When the file outgrows kMaxFileSize the
+ * older half is thinned out and the file is rewritten.
+ *
+ * File layout: magic, then records tagged 'K' (keyframe) or 'D' (delta).
+ */
+class BatteryHistory {
+  public:
+    BatteryHistory(const char *path);
+    void Append(int charge_full, const int *bins);
+
+    static bool Decode(const std::string &data, std::vector<BatteryHistoryRecord> *records);
+    static void Encode(const std::vector<BatteryHistoryRecord> &records, std::string *data);
+
+  private:
+    const char *raw_path_;
+    std::string path_;
+    bool loaded_;
+    bool have_last_;
+    BatteryHistoryRecord last_;
+    size_t since_keyframe_;
+    size_t file_size_;
+
+    void Load();
+    void Compact();
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_BATTERYHISTORY_H
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Decodes a battery history file (/persist/battery/battery_history) and
+ * estimates capacity fade per charge cycle.
+ *
+ *   battery_history_reader [-v] <file>
+ */
+
+#include <android-base/file.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "BatteryHistory.h"
+
+using ::device::google::wahoo::health::BatteryHistory;
+using ::device::google::wahoo::health::BatteryHistoryRecord;
+using ::device::google::wahoo::health::kBucketCount;
+
+// The fuel gauge reports the cycle count as the average of its bins.
+static double Cycles(const BatteryHistoryRecord &rec) {
+    double sum = 0;
+    for (int i = 0; i < kBucketCount; i++)
+        sum += rec.bins[i];
+    return sum / kBucketCount;
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 2 && !strcmp(argv[1], "-v");
+    if (argc != (verbose ? 3 : 2)) {
+        fprintf(stderr, "usage: %s [-v] <battery_history file>\n", argv[0]);
+        return 1;
+    }
+
+    std::string data;
+    if (!android::base::ReadFileToString(argv[argc - 1], &data)) {
+        perror(argv[argc - 1]);
+        return 1;
+    }
+
+    std::vector<BatteryHistoryRecord> records;
+    if (!BatteryHistory::Decode(data, &records))
+        fprintf(stderr, "warning: file is truncated or corrupt after %zu records\n",
+                records.size());
+    if (records.empty()) {
+        fprintf(stderr, "no records\n");
+        return 1;
+    }
+
+    if (verbose) {
+        printf("%-20s %10s %8s  bins\n", "time", "cap(uAh)", "cycles");
+        for (const auto &rec : records) {
+            char when[32];
+            time_t t = rec.timestamp;
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+            printf("%-20s %10d %8.1f ", when, rec.charge_full, Cycles(rec));
+            for (int i = 0; i < kBucketCount; i++)
+                printf(" %d", rec.bins[i]);
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    // Least squares fit of learned capacity against cycle count.
+    double n = records.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const auto &rec : records) {
+        double x = Cycles(rec), y = rec.charge_full;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    const BatteryHistoryRecord &first = records.front();
+    const BatteryHistoryRecord &last = records.back();
+    double cycles = Cycles(last) - Cycles(first);
+
+    printf("records:          %zu\n", records.size());
+    printf("span:             %.1f days\n", (last.timestamp - first.timestamp) / 86400.0);
+    printf("cycles:           %.1f -> %.1f\n", Cycles(first), Cycles(last));
+    printf("capacity:         %d -> %d uAh (%.2f%%)\n", first.charge_full, last.charge_full,
+           100.0 * (last.charge_full - first.charge_full) / first.charge_full);
+
+    double denom = n * sxx - sx * sx;
+    if (cycles <= 0 || denom == 0) {
+        printf("fade per cycle:   n/a (no cycles recorded)\n");
+        return 0;
+    }
+
+    double slope = (n * sxy - sx * sy) / denom;
+    printf("fade per cycle:   %.1f uAh (%.4f%% of first capacity)\n", -slope,
+           -100.0 * slope / first.charge_full);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatteryTelemetry.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr char kTelemetryPeriodProp[] = "persist.vendor.health.telemetry_ms";
+static constexpr uint32_t kMinPeriodMs = 10;
+// 32768 samples: about 55 minutes at 100ms, in 768KB.
+static constexpr size_t kRingRecords = 32768;
+static constexpr size_t kRingBytes = kRingRecords * sizeof(TelemetryRecord);
+
+static constexpr const char *kAttrPaths[] = {
+    "/sys/class/power_supply/bms/current_now",
+    "/sys/class/power_supply/bms/voltage_now",
+    "/sys/class/power_supply/bms/temp",
+    "/sys/class/power_supply/battery/capacity",
+};
+
+static uint64_t NowNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+BatteryTelemetry::BatteryTelemetry(SysfsReader *reader)
+    : reader_(reader), ring_(nullptr), written_(0), read_errors_(0), stop_(false), period_ms_(0) {
+    for (int i = 0; i < kNumAttrs; i++)
+        attrs_[i] = reader->Register(kAttrPaths[i]);
+}
+
+BatteryTelemetry::~BatteryTelemetry() {
+    stop_ = true;
+    if (thread_.joinable())
+        thread_.join();
+    if (ring_)
+        munmap(ring_, kRingBytes);
+}
+
+void BatteryTelemetry::Start() {
+    period_ms_ = android::base::GetUintProperty<uint32_t>(kTelemetryPeriodProp, 0);
+    if (period_ms_ == 0)
+        return;
+    if (period_ms_ < kMinPeriodMs)
+        period_ms_ = kMinPeriodMs;
+
+    for (int i = 0; i < kNumAttrs; i++) {
+        int64_t val;
+        if (!reader_->ReadInt(attrs_[i], &val)) {
+            PLOG(ERROR) << kAttrPaths[i] << ": read failed, telemetry disabled";
+            return;
+        }
+    }
+
+    void *ring = mmap(nullptr, kRingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1, 0);
+    if (ring == MAP_FAILED) {
+        PLOG(ERROR) << "Cannot map telemetry ring";
+        return;
+    }
+    ring_ = static_cast<TelemetryRecord *>(ring);
+
+    thread_ = std::thread(&BatteryTelemetry::SamplerLoop, this);
+    LOG(INFO) << "Battery telemetry sampling every " << period_ms_ << " ms";
+}
+
+bool BatteryTelemetry::ReadAttr(Attr attr, int64_t *val) {
+    if (!reader_->ReadInt(attrs_[attr], val)) {
+        read_errors_++;
+        return false;
+    }
+    return true;
+}
+
+void BatteryTelemetry::SamplerLoop() {
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!stop_) {
+        TelemetryRecord rec = {};
+        int64_t v;
+
+        rec.boottime_ns = NowNs(CLOCK_BOOTTIME);
+        if (ReadAttr(kCurrent, &v))
+            rec.current_ua = v;
+        if (ReadAttr(kVoltage, &v))
+            rec.voltage_uv = v;
+        if (ReadAttr(kTemp, &v))
+            rec.temp_decic = v;
+        if (ReadAttr(kSoc, &v))
+            rec.soc = v;
+
+        // Single writer: fill the slot, then publish it by bumping written_.
+        // The fence orders the previous bump before the slot stores, so a
+        // reader that copied any part of this record sees written_ >= n.
+        uint64_t n = written_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        ring_[n % kRingRecords] = rec;
+        written_.store(n + 1, std::memory_order_release);
+
+        next.tv_nsec += period_ms_ * 1000000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+}
+
+/*
+ * Copies the ring in chronological order without stopping the sampler.
+ * Slots the writer may have overwritten while they were being copied are
+ * dropped from the front of the result.
+ */
+size_t BatteryTelemetry::Snapshot(TelemetryRecord *out) const {
+    uint64_t end = written_.load(std::memory_order_acquire);
+    uint64_t begin = end > kRingRecords ? end - kRingRecords : 0;
+
+    for (uint64_t i = begin; i < end; i++)
+        out[i - begin] = ring_[i % kRingRecords];
+
+    // Keeps the second load from being satisfied before the copies above;
+    // pairs with the fence in SamplerLoop().
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now = written_.load(std::memory_order_relaxed);
+    uint64_t valid_begin = now >= kRingRecords ? now - kRingRecords + 1 : 0;
+    size_t skip = valid_begin > begin ? valid_begin - begin : 0;
+    if (skip >= end - begin)
+        return 0;
+    if (skip)
+        memmove(out, out + skip, (end - begin - skip) * sizeof(TelemetryRecord));
+    return end - begin - skip;
+}
+
+void BatteryTelemetry::Dump(int fd) const {
+    if (!ring_) {
+        android::base::WriteStringToFd("  disabled (set " + std::string(kTelemetryPeriodProp) +
+                                           ")\n",
+                                       fd);
+        return;
+    }
+    android::base::WriteStringToFd(
+        android::base::StringPrintf("  period %u ms, %" PRIu64 " samples, %" PRIu64
+                                    " read errors, ring holds %zu\n",
+                                    period_ms_, written_.load(), read_errors_.load(),
+                                    kRingRecords),
+        fd);
+}
+
+void BatteryTelemetry::DumpCsv(int fd) const {
+    if (!ring_)
+        return;
+
+    std::unique_ptr<TelemetryRecord[]> records(new TelemetryRecord[kRingRecords]);
+    size_t count = Snapshot(records.get());
+
+    std::string out = "boottime_ns,current_ua,voltage_uv,temp_decic,soc\n";
+    for (size_t i = 0; i < count; i++) {
+        const TelemetryRecord &r = records[i];
+        android::base::StringAppendF(&out, "%" PRIu64 ",%d,%d,%d,%u\n", r.boottime_ns,
+                                     r.current_ua, r.voltage_uv, r.temp_decic, r.soc);
+    }
+    android::base::WriteStringToFd(out, fd);
+}
+
+void BatteryTelemetry::DumpRaw(int fd) const {
+    if (!ring_)
+        return;
+
+    std::unique_ptr<TelemetryRecord[]> records(new TelemetryRecord[kRingRecords]);
+    size_t count = Snapshot(records.get());
+    android::base::WriteFully(fd, records.get(), count * sizeof(TelemetryRecord));
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_BATTERYTELEMETRY_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_BATTERYTELEMETRY_H
+
+#include <atomic>
+#include <thread>
+
+#include "SysfsReader.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+// One sample as stored in the ring and as exported by DumpRaw().
+struct TelemetryRecord {
+    uint64_t boottime_ns;
+    int32_t current_ua;
+    int32_t voltage_uv;
+    int16_t temp_decic;
+    uint8_t soc;
+    uint8_t reserved[5];
+};
+static_assert(sizeof(TelemetryRecord) == 24, "TelemetryRecord layout changed");
+
+/*
+ * Samples battery current, voltage, temperature and SOC at a sub-second
+ * period into a fixed size ring for charging investigations. Enabled by
+ * setting persist.vendor.health.telemetry_ms; when it is unset no thread is
+ * started, no file is opened and no memory is mapped.
+ */
+class BatteryTelemetry {
+  public:
+    BatteryTelemetry(SysfsReader *reader);
+    ~BatteryTelemetry();
+    void Start();
+    void Dump(int fd) const;
+    void DumpCsv(int fd) const;
+    void DumpRaw(int fd) const;
+
+  private:
+    enum Attr { kCurrent = 0, kVoltage, kTemp, kSoc, kNumAttrs };
+
+    SysfsReader *reader_;
+    SysfsReader::Handle attrs_[kNumAttrs];
+    TelemetryRecord *ring_;
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> read_errors_;
+    std::atomic<bool> stop_;
+    uint32_t period_ms_;
+    std::thread thread_;
+
+    bool ReadAttr(Attr attr, int64_t *val);
+    void SamplerLoop();
+    size_t Snapshot(TelemetryRecord *out) const;
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_BATTERYTELEMETRY_H
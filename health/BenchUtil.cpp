@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BenchUtil.h"
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+bool SyscallCount(uint64_t *count) {
+    // Read with a fixed buffer so the count itself stays cheap.
+    char buf[512];
+    int fd = TEMP_FAILURE_RETRY(open("/proc/self/io", O_RDONLY | O_CLOEXEC));
+    if (fd < 0)
+        return false;
+    ssize_t len = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf) - 1));
+    close(fd);
+    if (len <= 0)
+        return false;
+    buf[len] = '\0';
+
+    unsigned long long syscr, syscw;
+    const char *r = strstr(buf, "syscr: ");
+    const char *w = strstr(buf, "syscw: ");
+    if (!r || !w || sscanf(r, "syscr: %llu", &syscr) != 1 ||
+        sscanf(w, "syscw: %llu", &syscw) != 1)
+        return false;
+    *count = syscr + syscw;
+    return true;
+}
+
+void ReportSyscalls(benchmark::State &state, uint64_t start) {
+    uint64_t end;
+    if (state.iterations() && SyscallCount(&end))
+        state.counters["syscalls"] = static_cast<double>(end - start) / state.iterations();
+}
+
+std::string MakeBenchRoot() {
+    const char *tmp = getenv("TMPDIR");
+    std::string root = std::string(tmp ? tmp : "/data/local/tmp") + "/health_bench.XXXXXX";
+    if (!mkdtemp(&root[0])) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    return root;
+}
+
+void RemoveBenchRoot(const std::string &root) {
+    nftw(root.c_str(),
+         [](const char *path, const struct stat *, int, struct FTW *) { return remove(path); }, 16,
+         FTW_DEPTH | FTW_PHYS);
+}
+
+bool MakeTreeDir(const std::string &root, const std::string &path) {
+    std::string dir = root;
+    for (const auto &part : android::base::Split(path, "/")) {
+        if (part.empty())
+            continue;
+        dir += "/" + part;
+        if (mkdir(dir.c_str(), 0770) && errno != EEXIST) {
+            perror(dir.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteTreeFile(const std::string &root, const std::string &path, const std::string &data) {
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && !MakeTreeDir(root, path.substr(0, slash)))
+        return false;
+    if (!android::base::WriteStringToFile(data, root + path)) {
+        perror((root + path).c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
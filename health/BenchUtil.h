@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_BENCHUTIL_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_BENCHUTIL_H
+
+#include <benchmark/benchmark.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+/*
+ * Helpers shared by the health benchmarks.
+ */
+
+// Read and write class syscalls (syscr + syscw of /proc/self/io) so far;
+// opens and stats are not included. False if the kernel does not account
+// task I/O.
+bool SyscallCount(uint64_t *count);
+
+// Reports the syscalls made since |start|, from SyscallCount(), as a
+// per-iteration "syscalls" counter.
+void ReportSyscalls(benchmark::State &state, uint64_t start);
+
+// Creates a fresh directory to use as the health root.
+std::string MakeBenchRoot();
+void RemoveBenchRoot(const std::string &root);
+
+// Writes |data| to |root| + |path|, creating the parent directories.
+bool WriteTreeFile(const std::string &root, const std::string &path, const std::string &data);
+bool MakeTreeDir(const std::string &root, const std::string &path);
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_BENCHUTIL_H
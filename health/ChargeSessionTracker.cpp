@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChargeSessionTracker.h"
+#include "HealthPaths.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr char kSessionsFile[] = "/persist/battery/charge_sessions";
+static constexpr char kMagic[] = "WCS1";
+static constexpr size_t kMagicLen = sizeof(kMagic) - 1;
+static constexpr size_t kMaxSessions = 16;
+
+// Current is positive into the battery, as reported to BatteryManager.
+static constexpr const char *kAttrPaths[] = {
+    "/sys/class/power_supply/battery/current_now",
+    "/sys/class/power_supply/battery/voltage_now",
+    "/sys/class/power_supply/battery/system_temp_level",
+    "/sys/class/power_supply/battery/input_current_limited",
+    "/sys/class/power_supply/usb/input_current_now",
+    "/sys/class/power_supply/usb/voltage_now",
+};
+
+ChargeSessionTracker::ChargeSessionTracker(SysfsReader *reader)
+    : reader_(reader), active_(false), cur_{}, last_batt_mw_(0), last_usb_mw_(0) {
+    for (int i = 0; i < kNumAttrs; i++)
+        attrs_[i] = reader->Register(kAttrPaths[i]);
+}
+
+void ChargeSessionTracker::Restore() {
+    std::string data;
+
+    if (!android::base::ReadFileToString(HealthPath(kSessionsFile), &data))
+        return;
+
+    if (data.size() < kMagicLen || data.compare(0, kMagicLen, kMagic) != 0 ||
+        (data.size() - kMagicLen) % sizeof(ChargeSessionRecord) != 0) {
+        LOG(ERROR) << kSessionsFile << ": unexpected format, ignoring";
+        return;
+    }
+
+    size_t count = (data.size() - kMagicLen) / sizeof(ChargeSessionRecord);
+    history_.resize(std::min(count, kMaxSessions));
+    size_t bytes = history_.size() * sizeof(ChargeSessionRecord);
+    memcpy(history_.data(), data.data() + data.size() - bytes, bytes);
+}
+
+void ChargeSessionTracker::Save() {
+    std::string data(kMagic, kMagicLen);
+    data.append(reinterpret_cast<const char *>(history_.data()),
+                history_.size() * sizeof(ChargeSessionRecord));
+
+    if (!android::base::WriteStringToFile(data, HealthPath(kSessionsFile)))
+        PLOG(ERROR) << kSessionsFile << ": write failed";
+}
+
+bool ChargeSessionTracker::ReadAttr(Attr attr, int64_t *val) {
+    return reader_->ReadInt(attrs_[attr], val);
+}
+
+// Battery and charger input power in mW; uA * uV = 1e-9 mW.
+static double PowerMw(int64_t ua, int64_t uv) {
+    return static_cast<double>(ua) * uv / 1e9;
+}
+
+// Power into the battery in mW. The fuel gauge reports current_now as
+// negative while the battery charges.
+static double BatteryInMw(int64_t ua, int64_t uv) {
+    return -PowerMw(ua, uv);
+}
+
+void ChargeSessionTracker::Update(const struct android::BatteryProperties *props) {
+    bool online = props->chargerAcOnline || props->chargerUsbOnline ||
+                  props->chargerWirelessOnline;
+
+    if (!active_ && !online)
+        return;
+
+    if (!active_) {
+        int64_t ua = 0, uv = 0;
+
+        cur_ = {};
+        cur_.start_time = time(nullptr);
+        cur_.start_soc = props->batteryLevel;
+        cur_.charger = (props->chargerAcOnline ? 1 : 0) | (props->chargerUsbOnline ? 2 : 0) |
+                       (props->chargerWirelessOnline ? 4 : 0);
+        ReadAttr(kBattCurrent, &ua);
+        ReadAttr(kBattVoltage, &uv);
+        last_batt_mw_ = BatteryInMw(ua, uv);
+        ua = uv = 0;
+        ReadAttr(kUsbCurrent, &ua);
+        ReadAttr(kUsbVoltage, &uv);
+        last_usb_mw_ = PowerMw(ua, uv);
+        last_time_ = android::base::boot_clock::now();
+        active_ = true;
+        return;
+    }
+
+    Integrate(props);
+    if (!online)
+        Finish(props);
+}
+
+/*
+ * Trapezoidal integration between two battery updates. Updates arrive on
+ * every power_supply uevent and at least once a minute while charging, so
+ * the error is bounded by how fast the charge current ramps.
+ */
+void ChargeSessionTracker::Integrate(const struct android::BatteryProperties *props) {
+    auto now = android::base::boot_clock::now();
+    uint64_t dt_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - last_time_).count();
+    double dt_h = dt_ms / 3600000.0;
+    int64_t ua = 0, uv = 0, level = 0, limited = 0;
+
+    ReadAttr(kBattCurrent, &ua);
+    ReadAttr(kBattVoltage, &uv);
+    double batt_mw = BatteryInMw(ua, uv);
+    double avg_mw = (batt_mw + last_batt_mw_) / 2;
+    if (avg_mw >= 0)
+        cur_.energy_in_mwh += avg_mw * dt_h;
+    else
+        cur_.energy_out_mwh -= avg_mw * dt_h;
+
+    ua = uv = 0;
+    ReadAttr(kUsbCurrent, &ua);
+    ReadAttr(kUsbVoltage, &uv);
+    double usb_mw = PowerMw(ua, uv);
+    cur_.charger_energy_mwh += (usb_mw + last_usb_mw_) / 2 * dt_h;
+
+    ReadAttr(kTempLevel, &level);
+    ReadAttr(kCurrentLimited, &limited);
+    level = std::clamp<int64_t>(level, 0, kThermalLevels - 1);
+    cur_.regime_s[level][limited ? 1 : 0] += (dt_ms + 500) / 1000;
+
+    cur_.end_soc = props->batteryLevel;
+    last_batt_mw_ = batt_mw;
+    last_usb_mw_ = usb_mw;
+    last_time_ = now;
+}
+
+void ChargeSessionTracker::Finish(const struct android::BatteryProperties *props) {
+    cur_.duration_s = time(nullptr) - cur_.start_time;
+    cur_.end_soc = props->batteryLevel;
+    active_ = false;
+
+    if (history_.size() >= kMaxSessions)
+        history_.erase(history_.begin());
+    history_.push_back(cur_);
+    Save();
+}
+
+static void DumpSession(const ChargeSessionRecord &s, uint32_t duration_s, std::string *out) {
+    char when[32];
+    time_t t = s.start_time;
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+
+    double efficiency =
+        s.charger_energy_mwh > 0 ? 100.0 * s.energy_in_mwh / s.charger_energy_mwh : 0;
+    android::base::StringAppendF(out,
+                                 "  %s %5um soc %3u->%3u in %7.1f out %6.1f charger %7.1f mWh "
+                                 "eff %5.1f%%\n",
+                                 when, duration_s / 60, s.start_soc, s.end_soc, s.energy_in_mwh,
+                                 s.energy_out_mwh, s.charger_energy_mwh, efficiency);
+
+    std::string regimes;
+    for (int level = 0; level < kThermalLevels; level++) {
+        for (int limited = 0; limited < 2; limited++) {
+            if (s.regime_s[level][limited])
+                android::base::StringAppendF(&regimes, " L%d%s:%us", level, limited ? "*" : "",
+                                             s.regime_s[level][limited]);
+        }
+    }
+    if (!regimes.empty())
+        *out += "    regimes (level, * = input limited):" + regimes + "\n";
+}
+
+bool ChargeSessionTracker::GetCurrent(ChargeSessionRecord *record) const {
+    if (!active_)
+        return false;
+    *record = cur_;
+    return true;
+}
+
+void ChargeSessionTracker::Dump(int fd) const {
+    std::string out;
+
+    if (active_) {
+        out += "  current session:\n";
+        DumpSession(cur_, time(nullptr) - cur_.start_time, &out);
+    }
+    for (auto it = history_.rbegin(); it != history_.rend(); ++it)
+        DumpSession(*it, it->duration_s, &out);
+    if (out.empty())
+        out = "  no sessions recorded\n";
+
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
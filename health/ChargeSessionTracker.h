@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_CHARGESESSIONTRACKER_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_CHARGESESSIONTRACKER_H
+
+#include <android-base/chrono_utils.h>
+#include <batteryservice/BatteryService.h>
+#include <string>
+#include <vector>
+
+#include "SysfsReader.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr int kThermalLevels = 8;
+
+// Persisted summary of one charge session, from plug-in to unplug.
+struct ChargeSessionRecord {
+    uint64_t start_time;  // seconds since the epoch
+    uint32_t duration_s;
+    uint8_t start_soc;
+    uint8_t end_soc;
+    uint8_t charger;  // bit 0 AC, bit 1 USB, bit 2 wireless
+    uint8_t reserved;
+    float energy_in_mwh;       // into the battery
+    float energy_out_mwh;      // drawn from the battery while plugged in
+    float charger_energy_mwh;  // delivered by the charger input
+    // Seconds spent at each system_temp_level, without and with the input
+    // current limited.
+    uint32_t regime_s[kThermalLevels][2];
+};
+
+/*
+ * Integrates battery current x voltage between battery updates for as long
+ * as a charger is online, together with the time spent in each thermal and
+ * input-current-limit regime. Finished sessions are kept in a small ring in
+ * /persist/battery.
+ */
+class ChargeSessionTracker {
+  public:
+    ChargeSessionTracker(SysfsReader *reader);
+    void Restore();
+    void Update(const struct android::BatteryProperties *props);
+    // The session in progress; false while no charger is online.
+    bool GetCurrent(ChargeSessionRecord *record) const;
+    void Dump(int fd) const;
+
+  private:
+    enum Attr {
+        kBattCurrent = 0,
+        kBattVoltage,
+        kTempLevel,
+        kCurrentLimited,
+        kUsbCurrent,
+        kUsbVoltage,
+        kNumAttrs
+    };
+
+    SysfsReader *reader_;
+    SysfsReader::Handle attrs_[kNumAttrs];
+    bool active_;
+    ChargeSessionRecord cur_;
+    android::base::boot_clock::time_point last_time_;
+    double last_batt_mw_;
+    double last_usb_mw_;
+    std::vector<ChargeSessionRecord> history_;
+
+    bool ReadAttr(Attr attr, int64_t *val);
+    void Integrate(const struct android::BatteryProperties *props);
+    void Finish(const struct android::BatteryProperties *props);
+    void Save();
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_CHARGESESSIONTRACKER_H
@@ -16,16 +16,23 @@
 
 #include "CycleCountBackupRestore.h"
 
+#include <string.h>
+
 namespace device {
 namespace google {
 namespace wahoo {
 namespace health {
 
-static constexpr char kCycCntFile[] = "sys/class/power_supply/bms/device/cycle_counts_bins";
+static constexpr char kCycCntFile[] = "/sys/class/power_supply/bms/device/cycle_counts_bins";
 static constexpr char kSysPersistFile[] = "/persist/battery/qcom_cycle_counts_bins";
 static constexpr int kBuffSize = 256;
 
-CycleCountBackupRestore::CycleCountBackupRestore() { }
+CycleCountBackupRestore::CycleCountBackupRestore(SysfsReader *reader)
+    : reader_(reader),
+      sram_file_(reader->Register(kCycCntFile, true)),
+      storage_file_(reader->Register(kSysPersistFile, true)),
+      sw_bins_{},
+      hw_bins_{} { }
 
 void CycleCountBackupRestore::Restore()
 {
@@ -42,14 +49,14 @@ void CycleCountBackupRestore::Backup()
 
 void CycleCountBackupRestore::ReadFromStorage()
 {
-    std::string buffer;
+    char buffer[kBuffSize];
 
-    if (!android::base::ReadFileToString(std::string(kSysPersistFile), &buffer)) {
+    if (reader_->Read(storage_file_, buffer, sizeof(buffer)) < 0) {
         LOG(ERROR) << "Cannot read the storage file";
         return;
     }
 
-    if (sscanf(buffer.c_str(), "%d %d %d %d %d %d %d %d",
+    if (sscanf(buffer, "%d %d %d %d %d %d %d %d",
                &sw_bins_[0], &sw_bins_[1], &sw_bins_[2], &sw_bins_[3],
                &sw_bins_[4], &sw_bins_[5], &sw_bins_[6], &sw_bins_[7])
         != kBucketCount)
@@ -68,22 +75,20 @@ void CycleCountBackupRestore::SaveToStorage()
 
     LOG(INFO) << "Save to Storage: " << strData;
 
-    if (!android::base::WriteStringToFile(strData, std::string(kSysPersistFile)))
+    if (!reader_->Write(storage_file_, strData, strlen(strData)))
         LOG(ERROR) << "Write file error: " << strerror(errno);
 }
 
 void CycleCountBackupRestore::ReadFromSRAM()
 {
-    std::string buffer;
+    char buffer[kBuffSize];
 
-    if (!android::base::ReadFileToString(std::string(kCycCntFile), &buffer)) {
+    if (reader_->Read(sram_file_, buffer, sizeof(buffer)) < 0) {
         LOG(ERROR) << "Read cycle counter error: " << strerror(errno);
         return;
     }
 
-    buffer = android::base::Trim(buffer);
-
-    if (sscanf(buffer.c_str(), "%d %d %d %d %d %d %d %d",
+    if (sscanf(buffer, "%d %d %d %d %d %d %d %d",
                &hw_bins_[0], &hw_bins_[1], &hw_bins_[2], &hw_bins_[3],
                &hw_bins_[4], &hw_bins_[5], &hw_bins_[6], &hw_bins_[7])
         != kBucketCount)
@@ -102,7 +107,7 @@ void CycleCountBackupRestore::SaveToSRAM()
 
     LOG(INFO) << "Save to SRAM: "  << strData ;
 
-    if (!android::base::WriteStringToFile(strData, std::string(kCycCntFile)))
+    if (!reader_->Write(sram_file_, strData, strlen(strData)))
         LOG(ERROR) << "Write data error: " << strerror(errno);
 }
 
@@ -17,11 +17,10 @@
 #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_CYCLECOUNTBACKUPRESTORE_H
 #define DEVICE_GOOGLE_WAHOO_HEALTH_CYCLECOUNTBACKUPRESTORE_H
 
-#include <string>
-#include <android-base/file.h>
-#include <android-base/strings.h>
 #include <android-base/logging.h>
 
+#include "SysfsReader.h"
+
 namespace device {
 namespace google {
 namespace wahoo {
@@ -31,11 +30,15 @@ static constexpr int kBucketCount = 8;
 
 class CycleCountBackupRestore {
 public:
-    CycleCountBackupRestore();
+    CycleCountBackupRestore(SysfsReader *reader);
     void Restore();
     void Backup();
+    const int *GetBins() const { return sw_bins_; }
 
 private:
+    SysfsReader *reader_;
+    SysfsReader::Handle sram_file_;
+    SysfsReader::Handle storage_file_;
     int sw_bins_[kBucketCount];
     int hw_bins_[kBucketCount];
 
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DiskStatsTracker.h"
+#include "HealthPaths.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr char kSysBlockDir[] = "/sys/block";
+static constexpr char kProcDiskStatsFile[] = "/proc/diskstats";
+static constexpr size_t kDiskStatsFields = 11;
+static constexpr uint64_t kSectorSize = 512;
+// Back to back queries (e.g. getHealthInfo() right after getDiskStats()) would
+// otherwise produce meaningless rates over a few microseconds.
+static constexpr uint64_t kMinIntervalMs = 1000;
+// The LUN reported as the boot device in entry 0.
+static constexpr char kBootLun[] = "sda";
+
+static inline uint32_t DevKey(uint32_t major, uint32_t minor) {
+    return (major << 20) | minor;
+}
+
+static const char *SkipSpaces(const char *p, const char *end) {
+    while (p < end && *p == ' ')
+        p++;
+    return p;
+}
+
+static const char *ParseUint(const char *p, const char *end, uint64_t *val) {
+    uint64_t n = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        n = n * 10 + (*p++ - '0');
+    *val = n;
+    return p;
+}
+
+/*
+ * Implementation based on parse_disk_stats() in system/core/storaged_diskstats.cpp,
+ * without the stringstream and without assuming the layout of DiskStats.
+ */
+bool ParseDiskStats(const char *buf, size_t len, DiskStats *stats) {
+    uint64_t v[kDiskStatsFields];
+    const char *p = buf;
+    const char *end = buf + len;
+
+    for (size_t i = 0; i < kDiskStatsFields; i++) {
+        p = SkipSpaces(p, end);
+        if (p == end || *p < '0' || *p > '9')
+            return false;
+        p = ParseUint(p, end, &v[i]);
+    }
+
+    stats->reads = v[0];
+    stats->readMerges = v[1];
+    stats->readSectors = v[2];
+    stats->readTicks = v[3];
+    stats->writes = v[4];
+    stats->writeMerges = v[5];
+    stats->writeSectors = v[6];
+    stats->writeTicks = v[7];
+    stats->ioInFlight = v[8];
+    stats->ioTicks = v[9];
+    stats->ioInQueue = v[10];
+    return true;
+}
+
+// Counters reset when the device is re-registered; treat that as no activity.
+static uint64_t CounterDelta(uint64_t cur, uint64_t prev) {
+    return cur >= prev ? cur - prev : 0;
+}
+
+static void ComputeRates(const DiskStats &cur, const DiskStats &prev, uint64_t interval_ms,
+                         DiskStatsRates *rates) {
+    uint64_t reads = CounterDelta(cur.reads, prev.reads);
+    uint64_t writes = CounterDelta(cur.writes, prev.writes);
+    uint64_t ios = reads + writes;
+    uint64_t ticks = CounterDelta(cur.readTicks, prev.readTicks) +
+                     CounterDelta(cur.writeTicks, prev.writeTicks);
+    uint64_t busy = CounterDelta(cur.ioTicks, prev.ioTicks);
+    double secs = interval_ms / 1000.0;
+
+    rates->intervalMs = interval_ms;
+    rates->readIops = reads / secs;
+    rates->writeIops = writes / secs;
+    rates->readKBps = CounterDelta(cur.readSectors, prev.readSectors) * kSectorSize / 1024.0 / secs;
+    rates->writeKBps =
+        CounterDelta(cur.writeSectors, prev.writeSectors) * kSectorSize / 1024.0 / secs;
+    rates->avgServiceMs = ios ? static_cast<double>(busy) / ios : 0;
+    rates->avgWaitMs = ios ? static_cast<double>(ticks) / ios : 0;
+    rates->avgQueueDepth =
+        static_cast<double>(CounterDelta(cur.ioInQueue, prev.ioInQueue)) / interval_ms;
+    rates->utilization = 100.0 * busy / interval_ms;
+}
+
+// Adds the counters of one LUN into the whole-device total. The LUNs share
+// one UFS link, so busy time is the longest of them rather than the sum.
+static void Accumulate(const DiskStats &lun, DiskStats *total) {
+    total->reads += lun.reads;
+    total->readMerges += lun.readMerges;
+    total->readSectors += lun.readSectors;
+    total->readTicks += lun.readTicks;
+    total->writes += lun.writes;
+    total->writeMerges += lun.writeMerges;
+    total->writeSectors += lun.writeSectors;
+    total->writeTicks += lun.writeTicks;
+    total->ioInFlight += lun.ioInFlight;
+    total->ioTicks = std::max(total->ioTicks, lun.ioTicks);
+    total->ioInQueue += lun.ioInQueue;
+}
+
+static bool IsLunName(const char *name) {
+    if (strncmp(name, "sd", 2) != 0 || name[2] == '\0')
+        return false;
+    for (const char *p = name + 2; *p; p++) {
+        if (*p < 'a' || *p > 'z')
+            return false;
+    }
+    return true;
+}
+
+DiskStatsTracker::DiskStatsTracker(SysfsReader *reader, const char *boot_name)
+    : boot_name_(boot_name),
+      total_{},
+      reader_(reader),
+      diskstats_file_(reader->Register(kProcDiskStatsFile)),
+      have_prev_(false),
+      have_rates_(false) {
+    total_.name = boot_name_ + "-all";
+    total_.is_lun = false;
+    total_.cur.attr.isInternal = true;
+    total_.cur.attr.isBootDevice = false;
+    total_.cur.attr.name = total_.name;
+}
+
+void DiskStatsTracker::AddDevice(const std::string &sysfs_dir, const std::string &name,
+                                 bool is_lun) {
+    std::string dev;
+    unsigned int major, minor;
+
+    if (!android::base::ReadFileToString(sysfs_dir + "/dev", &dev) ||
+        sscanf(dev.c_str(), "%u:%u", &major, &minor) != 2) {
+        LOG(ERROR) << sysfs_dir << ": cannot read device number";
+        return;
+    }
+
+    Device device = {};
+    device.name = name;
+    device.is_lun = is_lun;
+    device.cur.attr.isInternal = true;
+    device.cur.attr.isBootDevice = false;
+    device.cur.attr.name = name;
+    devices_.push_back(device);
+    index_[DevKey(major, minor)] = devices_.size() - 1;
+}
+
+void DiskStatsTracker::Discover() {
+    std::unique_ptr<DIR, decltype(&closedir)> block(opendir(HealthPath(kSysBlockDir).c_str()),
+                                                    closedir);
+    if (!block) {
+        PLOG(ERROR) << kSysBlockDir << ": opendir failed";
+        return;
+    }
+
+    std::vector<std::string> luns;
+    struct dirent *ent;
+    while ((ent = readdir(block.get())) != nullptr) {
+        if (IsLunName(ent->d_name))
+            luns.push_back(ent->d_name);
+    }
+    std::sort(luns.begin(), luns.end());
+
+    devices_.clear();
+    index_.clear();
+    for (const auto &lun : luns) {
+        std::string dir = HealthPath(kSysBlockDir) + "/" + lun;
+        AddDevice(dir, lun, true);
+
+        std::unique_ptr<DIR, decltype(&closedir)> parts(opendir(dir.c_str()), closedir);
+        if (!parts)
+            continue;
+
+        std::vector<std::string> names;
+        while ((ent = readdir(parts.get())) != nullptr) {
+            if (strncmp(ent->d_name, lun.c_str(), lun.size()) == 0 &&
+                !access((dir + "/" + ent->d_name + "/partition").c_str(), F_OK))
+                names.push_back(ent->d_name);
+        }
+        std::sort(names.begin(), names.end(), [](const std::string &a, const std::string &b) {
+            return a.size() != b.size() ? a.size() < b.size() : a < b;
+        });
+        for (const auto &name : names)
+            AddDevice(dir + "/" + name, name, false);
+    }
+
+    LOG(INFO) << "Tracking " << luns.size() << " LUNs, " << devices_.size() - luns.size()
+              << " partitions";
+}
+
+bool DiskStatsTracker::ReadAll() {
+    // The buffer keeps its capacity across calls, so after the first update
+    // the whole file is read without allocating.
+    if (!reader_->ReadAll(diskstats_file_, &buffer_)) {
+        PLOG(ERROR) << kProcDiskStatsFile << ": read failed";
+        return false;
+    }
+
+    for (auto &device : devices_)
+        device.seen = false;
+
+    const char *p = buffer_.data();
+    const char *end = p + buffer_.size();
+    while (p < end) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+
+        uint64_t major, minor;
+        const char *q = ParseUint(SkipSpaces(p, eol), eol, &major);
+        q = ParseUint(SkipSpaces(q, eol), eol, &minor);
+        q = SkipSpaces(q, eol);
+        while (q < eol && *q != ' ')
+            q++;
+
+        auto it = index_.find(DevKey(major, minor));
+        if (it != index_.end()) {
+            Device &device = devices_[it->second];
+            device.seen = ParseDiskStats(q, eol - q, &device.cur);
+        }
+
+        p = eol + 1;
+    }
+
+    return true;
+}
+
+bool DiskStatsTracker::Update(std::vector<DiskStats> *vec_stats) {
+    if (devices_.empty() || !ReadAll())
+        return false;
+
+    auto now = android::base::boot_clock::now();
+    uint64_t interval_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - prev_time_).count();
+    bool new_interval = !have_prev_ || interval_ms >= kMinIntervalMs;
+
+    DiskStats total = {};
+    total.attr = total_.cur.attr;
+
+    // A device seen for the first time (or again after missing an update)
+    // only seeds its previous sample; a delta against zero would report
+    // everything since boot as one interval. The total is reseeded whenever
+    // the set of LUNs it sums changes.
+    bool luns_changed = false;
+    bool have_boot = false;
+    vec_stats->clear();
+    vec_stats->resize(1);
+    for (auto &device : devices_) {
+        if (!device.seen) {
+            if (new_interval && device.have_prev) {
+                device.have_prev = false;
+                luns_changed |= device.is_lun;
+            }
+            continue;
+        }
+
+        if (device.is_lun) {
+            Accumulate(device.cur, &total);
+            vec_stats->push_back(device.cur);
+            if (device.name == kBootLun) {
+                DiskStats &boot = (*vec_stats)[0];
+                boot = device.cur;
+                boot.attr.isBootDevice = true;
+                boot.attr.name = boot_name_;
+                have_boot = true;
+            }
+        }
+
+        if (new_interval) {
+            if (device.have_prev)
+                ComputeRates(device.cur, device.prev, interval_ms, &device.rates);
+            else
+                luns_changed |= device.is_lun;
+            device.prev = device.cur;
+            device.have_prev = true;
+        }
+    }
+    vec_stats->push_back(total);
+
+    if (new_interval) {
+        total_.cur = total;
+        bool total_rates = have_prev_ && !luns_changed;
+        if (total_rates)
+            ComputeRates(total_.cur, total_.prev, interval_ms, &total_.rates);
+        total_.prev = total_.cur;
+        have_rates_ = total_rates || have_rates_;
+        have_prev_ = true;
+        prev_time_ = now;
+    }
+
+    if (!have_boot) {
+        vec_stats->clear();
+        return false;
+    }
+    return true;
+}
+
+void DiskStatsTracker::Dump(int fd) const {
+    std::string out;
+
+    if (!have_rates_) {
+        android::base::WriteStringToFd("  no interval sampled yet\n", fd);
+        return;
+    }
+
+    android::base::StringAppendF(&out, "  interval %" PRIu64 " ms\n", total_.rates.intervalMs);
+    out +=
+        "  device       r/s     w/s    rKB/s    wKB/s  svctm  await  queue  util\n";
+
+    auto dump_one = [&out](const Device &device) {
+        const DiskStatsRates &r = device.rates;
+        android::base::StringAppendF(&out,
+                                     "  %-8s %7.1f %7.1f %8.1f %8.1f %6.2f %6.2f %6.2f %5.1f%%\n",
+                                     device.name.c_str(), r.readIops, r.writeIops, r.readKBps,
+                                     r.writeKBps, r.avgServiceMs, r.avgWaitMs, r.avgQueueDepth,
+                                     r.utilization);
+    };
+
+    dump_one(total_);
+    for (const auto &device : devices_) {
+        // Idle partitions would only add noise to the dump.
+        if (!device.is_lun && device.rates.readIops == 0 && device.rates.writeIops == 0)
+            continue;
+        dump_one(device);
+    }
+
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_DISKSTATSTRACKER_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_DISKSTATSTRACKER_H
+
+#include <android-base/chrono_utils.h>
+#include <android/hardware/health/2.0/types.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SysfsReader.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+using android::hardware::health::V2_0::DiskStats;
+
+// Rates derived from two consecutive samples of a block device's counters.
+struct DiskStatsRates {
+    uint64_t intervalMs;
+    double readIops;
+    double writeIops;
+    double readKBps;
+    double writeKBps;
+    double avgServiceMs;  // busy time per completed request
+    double avgWaitMs;     // read + write ticks per completed request
+    double avgQueueDepth;
+    double utilization;   // percent of the interval the device was busy
+};
+
+// Parses the 11 counters of a block device stat line into |stats|.
+bool ParseDiskStats(const char *buf, size_t len, DiskStats *stats);
+
+/*
+ * Tracks every UFS LUN (sda..sdf) and its partitions. The table is built once
+ * from /sys/block by Discover(); each Update() then refreshes all of them
+ * from a single read of /proc/diskstats and keeps the previous sample so the
+ * rates over the interval since the last update are available to Dump().
+ */
+class DiskStatsTracker {
+  public:
+    DiskStatsTracker(SysfsReader *reader, const char *boot_name);
+    void Discover();
+    // Fills |vec_stats| with sda's counters named |boot_name|, as entry 0
+    // has always been and storaged expects, followed by one entry per LUN
+    // and last their sum, named |boot_name|-all. Fails, leaving |vec_stats|
+    // empty, if sda could not be read.
+    bool Update(std::vector<DiskStats> *vec_stats);
+    void Dump(int fd) const;
+
+  private:
+    struct Device {
+        std::string name;
+        bool is_lun;
+        bool seen;
+        bool have_prev;  // prev holds a sample of this device
+        DiskStats cur;
+        DiskStats prev;
+        DiskStatsRates rates;
+    };
+
+    std::string boot_name_;
+    Device total_;
+    std::vector<Device> devices_;
+    std::unordered_map<uint32_t, size_t> index_;  // dev_t -> devices_
+    SysfsReader *reader_;
+    SysfsReader::Handle diskstats_file_;
+    std::string buffer_;
+    android::base::boot_clock::time_point prev_time_;
+    bool have_prev_;
+    bool have_rates_;
+
+    void AddDevice(const std::string &sysfs_dir, const std::string &name, bool is_lun);
+    bool ReadAll();
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_DISKSTATSTRACKER_H
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the per-update healthd board callbacks against a synthetic
+ * sysfs, debugfs, procfs and /persist tree, reporting time and read/write
+ * syscalls per call. Init() runs once before the benchmarks: it restores
+ * and rewrites the persisted state, so timing it would measure that file
+ * I/O and its logging rather than the callbacks.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "ChargeSessionTracker.h"
+#include "HealthBoard.h"
+#include "HealthPaths.h"
+
+using ::device::google::wahoo::health::ChargeSessionRecord;
+using ::device::google::wahoo::health::ChargeSessionTracker;
+using ::device::google::wahoo::health::DiskStats;
+using ::device::google::wahoo::health::HealthBoard;
+using ::device::google::wahoo::health::MakeBenchRoot;
+using ::device::google::wahoo::health::MakeTreeDir;
+using ::device::google::wahoo::health::RemoveBenchRoot;
+using ::device::google::wahoo::health::ReportSyscalls;
+using ::device::google::wahoo::health::SetHealthRoot;
+using ::device::google::wahoo::health::StorageInfo;
+using ::device::google::wahoo::health::SyscallCount;
+using ::device::google::wahoo::health::SysfsReader;
+using ::device::google::wahoo::health::WriteTreeFile;
+
+static const struct {
+    const char *path;
+    const char *data;
+} kTree[] = {
+    {"/sys/class/power_supply/bms/device/cycle_counts_bins", "12 40 33 25 18 9 4 1\n"},
+    {"/sys/class/power_supply/bms/charge_full", "2650000\n"},
+    {"/sys/class/power_supply/bms/charge_full_design", "2700000\n"},
+    {"/sys/class/power_supply/battery/current_now", "-1200000\n"},
+    {"/sys/class/power_supply/battery/voltage_now", "4012000\n"},
+    {"/sys/class/power_supply/battery/system_temp_level", "0\n"},
+    {"/sys/class/power_supply/battery/input_current_limited", "0\n"},
+    {"/sys/class/power_supply/usb/input_current_now", "1480000\n"},
+    {"/sys/class/power_supply/usb/voltage_now", "5020000\n"},
+    {"/sys/kernel/debug/ufshcd0/show_hba",
+     "hba->ufs_version = 0x210\nhba->outstanding_reqs = 0x0\n"},
+    {"/sys/kernel/debug/ufshcd0/dump_health_desc",
+     "Health Descriptor[Byte offset 0x0]: bLength = 0x25\n"
+     "Health Descriptor[Byte offset 0x1]: bDescriptorType = 0x9\n"
+     "Health Descriptor[Byte offset 0x2]: bPreEOLInfo = 0x1\n"
+     "Health Descriptor[Byte offset 0x3]: bDeviceLifeTimeEstA = 0x2\n"
+     "Health Descriptor[Byte offset 0x4]: bDeviceLifeTimeEstB = 0x1\n"},
+    {"/sys/block/sda/dev", "8:0\n"},
+    {"/sys/block/sda/size", "119775232\n"},
+    {"/sys/block/sda/stat",
+     "  215836    31468  9966422   134170   190476   199396  8471960   451890"
+     "        0   194560   586500\n"},
+    {"/sys/block/sda/sda1/dev", "8:1\n"},
+    {"/sys/block/sda/sda1/partition", "1\n"},
+    {"/sys/block/sdb/dev", "8:16\n"},
+    {"/proc/diskstats",
+     "   7       0 loop0 12 0 96 1 0 0 0 0 0 1 1\n"
+     "   8       0 sda 215836 31468 9966422 134170 190476 199396 8471960 451890 0 194560 586500\n"
+     "   8       1 sda1 9012 0 72096 5210 0 0 0 0 0 4120 5210\n"
+     "   8      16 sdb 1084 0 8672 590 0 0 0 0 0 480 590\n"},
+};
+
+static HealthBoard *board;
+
+// The tree models charging: USB online and a negative battery current_now.
+// A session over it has to book energy into the battery, none out of it.
+static bool CheckChargeDirection() {
+    SysfsReader reader;
+    ChargeSessionTracker tracker(&reader);
+    struct android::BatteryProperties props = {};
+    props.chargerUsbOnline = true;
+    props.batteryLevel = 50;
+
+    tracker.Update(&props);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    tracker.Update(&props);
+
+    ChargeSessionRecord session;
+    if (!tracker.GetCurrent(&session) || session.energy_in_mwh <= 0 ||
+        session.energy_out_mwh != 0) {
+        fprintf(stderr, "charge session books %.4f mWh in, %.4f mWh out while charging\n",
+                session.energy_in_mwh, session.energy_out_mwh);
+        return false;
+    }
+    return true;
+}
+
+static void BM_BatteryUpdate(benchmark::State &state) {
+    struct android::BatteryProperties props = {};
+    props.chargerUsbOnline = true;
+    props.batteryLevel = 50;
+    uint64_t syscalls = 0;
+    SyscallCount(&syscalls);
+
+    for (auto _ : state)
+        board->BatteryUpdate(&props);
+    ReportSyscalls(state, syscalls);
+}
+BENCHMARK(BM_BatteryUpdate);
+
+static void BM_GetStorageInfo(benchmark::State &state) {
+    std::vector<StorageInfo> storage_info;
+    uint64_t syscalls = 0;
+    SyscallCount(&syscalls);
+
+    for (auto _ : state)
+        board->GetStorageInfo(&storage_info);
+    ReportSyscalls(state, syscalls);
+}
+BENCHMARK(BM_GetStorageInfo);
+
+static void BM_GetDiskStats(benchmark::State &state) {
+    std::vector<DiskStats> disk_stats;
+    uint64_t syscalls = 0;
+    SyscallCount(&syscalls);
+
+    for (auto _ : state)
+        board->GetDiskStats(&disk_stats);
+    ReportSyscalls(state, syscalls);
+}
+BENCHMARK(BM_GetDiskStats);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    std::string root = MakeBenchRoot();
+    for (const auto &file : kTree) {
+        if (!WriteTreeFile(root, file.path, file.data))
+            return 1;
+    }
+    if (!MakeTreeDir(root, "/persist/battery"))
+        return 1;
+
+    // Before the board exists: every path is resolved through the root.
+    SetHealthRoot(root);
+    if (!CheckChargeDirection())
+        return 1;
+    board = new HealthBoard();
+    board->Init();
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    delete board;
+    RemoveBenchRoot(root);
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HealthBoard.h"
+
+#include <android-base/file.h>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr int kBackupTrigger = 20;
+static constexpr char kUFSName[] = "UFS0";
+static constexpr char kBatteryHistoryFile[] = "/persist/battery/battery_history";
+
+HealthBoard::HealthBoard()
+    : cc_backup_restore_(&reader_),
+      lc_backup_restore_(&reader_),
+      storage_info_cache_(&reader_),
+      disk_stats_tracker_(&reader_, kUFSName),
+      battery_telemetry_(&reader_),
+      battery_history_(kBatteryHistoryFile),
+      charge_session_tracker_(&reader_),
+      ufs_wear_tracker_(&reader_),
+      saved_soc_(0),
+      soc_inc_(0),
+      is_first_(true) {}
+
+void HealthBoard::CycleCountBackup(int battery_level) {
+    if (is_first_) {
+        is_first_ = false;
+        saved_soc_ = battery_level;
+        return;
+    }
+
+    if (battery_level > saved_soc_)
+        soc_inc_ += battery_level - saved_soc_;
+
+    saved_soc_ = battery_level;
+
+    if (soc_inc_ >= kBackupTrigger) {
+        cc_backup_restore_.Backup();
+        soc_inc_ = 0;
+    }
+}
+
+void HealthBoard::Init() {
+    cc_backup_restore_.Restore();
+    lc_backup_restore_.Restore();
+    disk_stats_tracker_.Discover();
+    battery_telemetry_.Start();
+    charge_session_tracker_.Restore();
+    ufs_wear_tracker_.Restore();
+}
+
+void HealthBoard::BatteryUpdate(const struct android::BatteryProperties *props) {
+    CycleCountBackup(props->batteryLevel);
+    lc_backup_restore_.Backup();
+    battery_history_.Append(lc_backup_restore_.GetCapacity(), cc_backup_restore_.GetBins());
+    charge_session_tracker_.Update(props);
+
+    StorageInfo storage_info;
+    if (storage_info_cache_.Get(&storage_info))
+        ufs_wear_tracker_.Update(storage_info);
+}
+
+void HealthBoard::GetStorageInfo(std::vector<StorageInfo> *vec_storage_info) {
+    StorageInfo storage_info;
+
+    if (!storage_info_cache_.Get(&storage_info))
+        return;
+
+    vec_storage_info->resize(1);
+    (*vec_storage_info)[0] = storage_info;
+}
+
+void HealthBoard::GetDiskStats(std::vector<DiskStats> *vec_stats) {
+    disk_stats_tracker_.Update(vec_stats);
+}
+
+void HealthBoard::Dump(int fd) const {
+    android::base::WriteStringToFd("\nDisk stats:\n", fd);
+    disk_stats_tracker_.Dump(fd);
+    android::base::WriteStringToFd("\nBattery telemetry:\n", fd);
+    battery_telemetry_.Dump(fd);
+    android::base::WriteStringToFd("\nCharge sessions:\n", fd);
+    charge_session_tracker_.Dump(fd);
+    android::base::WriteStringToFd("\nUFS wear:\n", fd);
+    ufs_wear_tracker_.Dump(fd);
+    android::base::WriteStringToFd("\nFile access:\n", fd);
+    reader_.Dump(fd);
+}
+
+void HealthBoard::DumpTelemetryCsv(int fd) const {
+    battery_telemetry_.DumpCsv(fd);
+}
+
+void HealthBoard::DumpTelemetryRaw(int fd) const {
+    battery_telemetry_.DumpRaw(fd);
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_HEALTHBOARD_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_HEALTHBOARD_H
+
+#include <android/hardware/health/2.0/types.h>
+#include <batteryservice/BatteryService.h>
+#include <vector>
+
+#include "BatteryHistory.h"
+#include "BatteryTelemetry.h"
+#include "ChargeSessionTracker.h"
+#include "CycleCountBackupRestore.h"
+#include "DiskStatsTracker.h"
+#include "LearnedCapacityBackupRestore.h"
+#include "StorageInfoCache.h"
+#include "SysfsReader.h"
+#include "UfsWearTracker.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+using android::hardware::health::V2_0::DiskStats;
+using android::hardware::health::V2_0::StorageInfo;
+
+/*
+ * Everything behind the healthd board callbacks, so the service and the
+ * host benchmark run the same code. Paths are resolved through HealthPath(),
+ * so SetHealthRoot() has to be called before the first callback.
+ */
+class HealthBoard {
+  public:
+    HealthBoard();
+    void Init();
+    void BatteryUpdate(const struct android::BatteryProperties *props);
+    void GetStorageInfo(std::vector<StorageInfo> *vec_storage_info);
+    void GetDiskStats(std::vector<DiskStats> *vec_stats);
+
+    void Dump(int fd) const;
+    void DumpTelemetryCsv(int fd) const;
+    void DumpTelemetryRaw(int fd) const;
+
+  private:
+    // Shared by every component below, so it must be declared first.
+    SysfsReader reader_;
+    CycleCountBackupRestore cc_backup_restore_;
+    LearnedCapacityBackupRestore lc_backup_restore_;
+    StorageInfoCache storage_info_cache_;
+    DiskStatsTracker disk_stats_tracker_;
+    BatteryTelemetry battery_telemetry_;
+    BatteryHistory battery_history_;
+    ChargeSessionTracker charge_session_tracker_;
+    UfsWearTracker ufs_wear_tracker_;
+
+    // Cycle count backup trigger state.
+    int saved_soc_;
+    int soc_inc_;
+    bool is_first_;
+
+    void CycleCountBackup(int battery_level);
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_HEALTHBOARD_H
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_HEALTHPATHS_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_HEALTHPATHS_H
+
+#include <string>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+/*
+ * Every sysfs, debugfs, procfs and /persist path used by the health service
+ * goes through HealthPath(), so the whole service can be pointed at a fake
+ * tree, as health_bench does. The root is empty in the service; it must be
+ * set before the first file is opened, since opened descriptors are kept.
+ */
+inline std::string &HealthRoot() {
+    static std::string root;
+    return root;
+}
+
+inline void SetHealthRoot(const std::string &root) {
+    HealthRoot() = root;
+}
+
+inline std::string HealthPath(const char *path) {
+    return HealthRoot() + path;
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_HEALTHPATHS_H
@@ -22,157 +22,64 @@
 #include <hidl/HidlTransportSupport.h>
 
 #include <android-base/file.h>
-#include <android-base/strings.h>
 
 #include <vector>
 #include <string>
 
-#include "CycleCountBackupRestore.h"
-#include "LearnedCapacityBackupRestore.h"
+#include "HealthBoard.h"
+#include "WahooHealth.h"
 
 using android::hardware::health::V2_0::StorageInfo;
 using android::hardware::health::V2_0::DiskStats;
-using ::device::google::wahoo::health::CycleCountBackupRestore;
-using ::device::google::wahoo::health::LearnedCapacityBackupRestore;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using ::device::google::wahoo::health::HealthBoard;
+using ::device::google::wahoo::health::wahoo_health_service_main;
 
-static constexpr int kBackupTrigger = 20;
-static CycleCountBackupRestore ccBackupRestore;
-static LearnedCapacityBackupRestore lcBackupRestore;
-
-int cycle_count_backup(int battery_level)
-{
-    static int saved_soc = 0;
-    static int soc_inc = 0;
-    static bool is_first = true;
-
-    if (is_first) {
-        is_first = false;
-        saved_soc = battery_level;
-        return 0;
-    }
-
-    if (battery_level > saved_soc) {
-        soc_inc += battery_level - saved_soc;
-    }
-
-    saved_soc = battery_level;
-
-    if (soc_inc >= kBackupTrigger) {
-        ccBackupRestore.Backup();
-        soc_inc = 0;
-    }
-    return 0;
-}
+static HealthBoard board;
 
 // See : hardware/interfaces/health/2.0/README
 
 void healthd_board_init(struct healthd_config*)
 {
-    ccBackupRestore.Restore();
-    lcBackupRestore.Restore();
+    board.Init();
 }
 
 int healthd_board_battery_update(struct android::BatteryProperties *props)
 {
-    cycle_count_backup(props->batteryLevel);
-    lcBackupRestore.Backup();
+    board.BatteryUpdate(props);
     return 0;
 }
 
-const char kUFSHealthFile[] = "/sys/kernel/debug/ufshcd0/dump_health_desc";
-const char kUFSHealthVersionFile[] = "/sys/kernel/debug/ufshcd0/show_hba";
-const char kDiskStatsFile[] = "/sys/block/sda/stat";
-const char kUFSName[] = "UFS0";
-
-/*
- * Implementation based on system/core/storaged/storaged_info.cc
- */
 void get_storage_info(std::vector<StorageInfo>& vec_storage_info) {
-    StorageInfo storage_info = {};
-    std::string buffer, version;
-
-    storage_info.attr.isInternal = true;
-    storage_info.attr.isBootDevice = true;
-    storage_info.attr.name = std::string(kUFSName);
-
-    if (!android::base::ReadFileToString(std::string(kUFSHealthVersionFile), &version)) {
-        return;
-    }
-
-    std::vector<std::string> lines = android::base::Split(version, "\n");
-    if (lines.empty()) {
-        return;
-    }
-
-    char rev[8];
-    if (sscanf(lines[6].c_str(), "hba->ufs_version = 0x%7s\n", rev) < 1) {
-        return;
-    }
-
-    storage_info.version = "ufs " + std::string(rev);
-
-    if (!android::base::ReadFileToString(std::string(kUFSHealthFile), &buffer)) {
-        return;
-    }
-
-    lines = android::base::Split(buffer, "\n");
-    if (lines.empty()) {
-        return;
-    }
-
-    for (size_t i = 1; i < lines.size(); i++) {
-        char token[32];
-        uint16_t val;
-        int ret;
-        if ((ret = sscanf(lines[i].c_str(),
-                   "Health Descriptor[Byte offset 0x%*d]: %31s = 0x%hx",
-                   token, &val)) < 2) {
-            continue;
-        }
-
-        if (std::string(token) == "bPreEOLInfo") {
-            storage_info.eol = val;
-        } else if (std::string(token) == "bDeviceLifeTimeEstA") {
-            storage_info.lifetimeA = val;
-        } else if (std::string(token) == "bDeviceLifeTimeEstB") {
-            storage_info.lifetimeB = val;
-        }
-    }
+    board.GetStorageInfo(&vec_storage_info);
+}
 
-    vec_storage_info.resize(1);
-    vec_storage_info[0] = storage_info;
-    return;
+void get_disk_stats(std::vector<DiskStats>& vec_stats) {
+    board.GetDiskStats(&vec_stats);
 }
 
 /*
- * Implementation based on parse_disk_stats() in system/core/storaged_diskstats.cpp
+ * lshal debug android.hardware.health@2.0::IHealth/default [option]
+ *   (none)            default dump followed by the wahoo sections
+ *   --telemetry       battery telemetry ring as CSV
+ *   --telemetry-raw   battery telemetry ring as TelemetryRecord structs
  */
-void get_disk_stats(std::vector<DiskStats>& vec_stats) {
-    const size_t kDiskStatsSize = 11;
-    struct DiskStats stats = {};
-
-    stats.attr.isInternal = true;
-    stats.attr.isBootDevice = true;
-    stats.attr.name = std::string(kUFSName);
-
-
-    std::string buffer;
-    if (!android::base::ReadFileToString(std::string(kDiskStatsFile), &buffer)) {
-        LOG(ERROR) << kDiskStatsFile << ": ReadFileToString failed.";
+static void health_debug(int fd, const hidl_vec<hidl_string>& args) {
+    if (args.size() > 0) {
+        if (args[0] == "--telemetry") {
+            board.DumpTelemetryCsv(fd);
+        } else if (args[0] == "--telemetry-raw") {
+            board.DumpTelemetryRaw(fd);
+        } else {
+            android::base::WriteStringToFd("Unknown option " + std::string(args[0]) + "\n", fd);
+        }
         return;
     }
 
-    // Regular diskstats entries
-    std::stringstream ss(buffer);
-    for (uint i = 0; i < kDiskStatsSize; ++i) {
-        ss >> *(reinterpret_cast<uint64_t*>(&stats) + i);
-    }
-    vec_stats.resize(1);
-    vec_stats[0] = stats;
-
-    return;
+    board.Dump(fd);
 }
 
 int main(void) {
-    return health_service_main();
+    return wahoo_health_service_main(health_debug);
 }
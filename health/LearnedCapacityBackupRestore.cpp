@@ -16,17 +16,26 @@
 
 #include "LearnedCapacityBackupRestore.h"
 
+#include <string.h>
+
 namespace device {
 namespace google {
 namespace wahoo {
 namespace health {
 
-static constexpr char kChgFullDesignFile[] = "sys/class/power_supply/bms/charge_full_design";
-static constexpr char kChgFullFile[] = "sys/class/power_supply/bms/charge_full";
+static constexpr char kChgFullDesignFile[] = "/sys/class/power_supply/bms/charge_full_design";
+static constexpr char kChgFullFile[] = "/sys/class/power_supply/bms/charge_full";
 static constexpr char kSysCFPersistFile[] = "/persist/battery/qcom_charge_full";
 static constexpr int kBuffSize = 256;
 
-LearnedCapacityBackupRestore::LearnedCapacityBackupRestore() : sw_cap_(0), hw_cap_(0) {}
+LearnedCapacityBackupRestore::LearnedCapacityBackupRestore(SysfsReader *reader)
+    : reader_(reader),
+      full_design_file_(reader->Register(kChgFullDesignFile)),
+      full_file_(reader->Register(kChgFullFile, true)),
+      storage_file_(reader->Register(kSysCFPersistFile, true)),
+      sw_cap_(0),
+      hw_cap_(0),
+      nom_cap_(0) {}
 
 void LearnedCapacityBackupRestore::Restore() {
     ReadFromStorage();
@@ -53,14 +62,14 @@ void LearnedCapacityBackupRestore::Backup() {
 }
 
 void LearnedCapacityBackupRestore::ReadFromStorage() {
-    std::string buffer;
+    char buffer[kBuffSize];
 
-    if (!android::base::ReadFileToString(std::string(kSysCFPersistFile), &buffer)) {
+    if (reader_->Read(storage_file_, buffer, sizeof(buffer)) < 0) {
         LOG(ERROR) << "Cannot read the storage file";
         return;
     }
 
-    if (sscanf(buffer.c_str(), "%d", &sw_cap_) < 1)
+    if (sscanf(buffer, "%d", &sw_cap_) < 1)
         LOG(ERROR) << "data format is wrong in the storage file: " << buffer;
     else
         LOG(INFO) << "Storage data: " << buffer;
@@ -73,37 +82,33 @@ void LearnedCapacityBackupRestore::SaveToStorage() {
 
     LOG(INFO) << "Save to Storage: " << strData;
 
-    if (!android::base::WriteStringToFile(strData, std::string(kSysCFPersistFile)))
+    if (!reader_->Write(storage_file_, strData, strlen(strData)))
         LOG(ERROR) << "Write file error: " << strerror(errno);
 }
 
 void LearnedCapacityBackupRestore::ReadNominalCapacity() {
-    std::string buffer;
+    char buffer[kBuffSize];
 
-    if (!android::base::ReadFileToString(std::string(kChgFullDesignFile), &buffer)) {
+    if (reader_->Read(full_design_file_, buffer, sizeof(buffer)) < 0) {
         LOG(ERROR) << "Read nominal capacity error: " << strerror(errno);
         return;
     }
 
-    buffer = android::base::Trim(buffer);
-
-    if (sscanf(buffer.c_str(), "%d", &nom_cap_) < 1)
+    if (sscanf(buffer, "%d", &nom_cap_) < 1)
         LOG(ERROR) << "Failed to parse nominal capacity: " << buffer;
     else
         LOG(INFO) << "nominal capacity: " << buffer;
 }
 
 void LearnedCapacityBackupRestore::ReadFromSRAM() {
-    std::string buffer;
+    char buffer[kBuffSize];
 
-    if (!android::base::ReadFileToString(std::string(kChgFullFile), &buffer)) {
+    if (reader_->Read(full_file_, buffer, sizeof(buffer)) < 0) {
         LOG(ERROR) << "Read capacity error: " << strerror(errno);
         return;
     }
 
-    buffer = android::base::Trim(buffer);
-
-    if (sscanf(buffer.c_str(), "%d", &hw_cap_) < 1)
+    if (sscanf(buffer, "%d", &hw_cap_) < 1)
         LOG(ERROR) << "Failed to parse SRAM bins: " << buffer;
     else
         LOG(INFO) << "SRAM data: " << buffer;
@@ -116,7 +121,7 @@ void LearnedCapacityBackupRestore::SaveToSRAM() {
 
     LOG(INFO) << "Save to SRAM: " << strData;
 
-    if (!android::base::WriteStringToFile(strData, std::string(kChgFullFile)))
+    if (!reader_->Write(full_file_, strData, strlen(strData)))
         LOG(ERROR) << "Write data error: " << strerror(errno);
 }
 
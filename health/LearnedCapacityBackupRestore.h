@@ -17,10 +17,9 @@
 #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_LEARNEDCAPACITYBACKUPRESTORE_H
 #define DEVICE_GOOGLE_WAHOO_HEALTH_LEARNEDCAPACITYBACKUPRESTORE_H
 
-#include <android-base/file.h>
 #include <android-base/logging.h>
-#include <android-base/strings.h>
-#include <string>
+
+#include "SysfsReader.h"
 
 namespace device {
 namespace google {
@@ -29,11 +28,16 @@ namespace health {
 
 class LearnedCapacityBackupRestore {
   public:
-    LearnedCapacityBackupRestore();
+    LearnedCapacityBackupRestore(SysfsReader *reader);
     void Restore();
     void Backup();
+    int GetCapacity() const { return sw_cap_; }
 
   private:
+    SysfsReader *reader_;
+    SysfsReader::Handle full_design_file_;
+    SysfsReader::Handle full_file_;
+    SysfsReader::Handle storage_file_;
     int sw_cap_;
     int hw_cap_;
     int nom_cap_;
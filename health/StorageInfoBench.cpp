@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares StorageInfoCache with the per-call parsing it replaced. At start
+ * the device's show_hba and dump_health_desc are captured into a scratch
+ * health root, so every iteration parses the same real content. Reading
+ * debugfs needs root.
+ */
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "HealthPaths.h"
+#include "StorageInfoCache.h"
+#include "SysfsReader.h"
+
+using ::device::google::wahoo::health::HealthPath;
+using ::device::google::wahoo::health::MakeBenchRoot;
+using ::device::google::wahoo::health::RemoveBenchRoot;
+using ::device::google::wahoo::health::SetHealthRoot;
+using ::device::google::wahoo::health::StorageInfo;
+using ::device::google::wahoo::health::StorageInfoCache;
+using ::device::google::wahoo::health::SysfsReader;
+using ::device::google::wahoo::health::WriteTreeFile;
+
+static constexpr char kUFSDir[] = "/sys/kernel/debug/ufshcd0";
+
+// get_storage_info() before StorageInfoCache, kept as the baseline.
+static bool LegacyGetStorageInfo(StorageInfo *storage_info) {
+    std::string buffer, version;
+
+    if (!android::base::ReadFileToString(HealthPath("/sys/kernel/debug/ufshcd0/show_hba"),
+                                         &version))
+        return false;
+
+    std::vector<std::string> lines = android::base::Split(version, "\n");
+    if (lines.size() < 7)
+        return false;
+
+    char rev[8];
+    if (sscanf(lines[6].c_str(), "hba->ufs_version = 0x%7s\n", rev) < 1)
+        return false;
+
+    storage_info->version = "ufs " + std::string(rev);
+
+    if (!android::base::ReadFileToString(
+            HealthPath("/sys/kernel/debug/ufshcd0/dump_health_desc"), &buffer))
+        return false;
+
+    lines = android::base::Split(buffer, "\n");
+    for (size_t i = 1; i < lines.size(); i++) {
+        char token[32];
+        uint16_t val;
+        if (sscanf(lines[i].c_str(), "Health Descriptor[Byte offset 0x%*d]: %31s = 0x%hx", token,
+                   &val) < 2)
+            continue;
+
+        if (std::string(token) == "bPreEOLInfo")
+            storage_info->eol = val;
+        else if (std::string(token) == "bDeviceLifeTimeEstA")
+            storage_info->lifetimeA = val;
+        else if (std::string(token) == "bDeviceLifeTimeEstB")
+            storage_info->lifetimeB = val;
+    }
+    return true;
+}
+
+static void BM_Legacy(benchmark::State &state) {
+    StorageInfo info;
+    for (auto _ : state)
+        LegacyGetStorageInfo(&info);
+}
+BENCHMARK(BM_Legacy);
+
+// A new cache every call: open, read and parse both files.
+static void BM_CacheFirstCall(benchmark::State &state) {
+    StorageInfo info;
+    for (auto _ : state) {
+        SysfsReader reader;
+        StorageInfoCache cache(&reader);
+        cache.Get(&info);
+    }
+}
+BENCHMARK(BM_CacheFirstCall);
+
+static void BM_CacheCached(benchmark::State &state) {
+    SysfsReader reader;
+    StorageInfoCache cache(&reader);
+    StorageInfo info;
+    for (auto _ : state)
+        cache.Get(&info);
+}
+BENCHMARK(BM_CacheCached);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    std::string root = MakeBenchRoot();
+    for (const char *name : {"show_hba", "dump_health_desc"}) {
+        std::string path = std::string(kUFSDir) + "/" + name;
+        std::string data;
+        if (!android::base::ReadFileToString(path, &data)) {
+            perror(path.c_str());
+            return 1;
+        }
+        if (!WriteTreeFile(root, path, data))
+            return 1;
+    }
+    SetHealthRoot(root);
+
+    StorageInfo legacy = {}, cached = {};
+    SysfsReader reader;
+    StorageInfoCache cache(&reader);
+    if (!LegacyGetStorageInfo(&legacy) || !cache.Get(&cached)) {
+        fprintf(stderr, "cannot parse the captured %s files\n", kUFSDir);
+        return 1;
+    }
+    printf("%s: eol %u, lifetime A %u B %u\n", cached.version.c_str(), cached.eol,
+           cached.lifetimeA, cached.lifetimeB);
+    if (legacy.version != cached.version || legacy.eol != cached.eol ||
+        legacy.lifetimeA != cached.lifetimeA || legacy.lifetimeB != cached.lifetimeB) {
+        fprintf(stderr, "mismatch: legacy parse gives %s: eol %u, lifetime A %u B %u\n",
+                legacy.version.c_str(), legacy.eol, legacy.lifetimeA, legacy.lifetimeB);
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    RemoveBenchRoot(root);
+    return 0;
+}
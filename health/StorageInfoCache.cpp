@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StorageInfoCache.h"
+
+#include <android-base/logging.h>
+
+#include <algorithm>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr char kUFSHealthFile[] = "/sys/kernel/debug/ufshcd0/dump_health_desc";
+static constexpr char kUFSHealthVersionFile[] = "/sys/kernel/debug/ufshcd0/show_hba";
+static constexpr char kUFSName[] = "UFS0";
+
+static constexpr std::string_view kVersionKey = "hba->ufs_version = 0x";
+static constexpr std::string_view kDescSeparator = "]: ";
+static constexpr std::string_view kValueSeparator = " = 0x";
+static constexpr size_t kMaxVersionLen = 7;
+
+// Parses a hex number from the start of |s|, stopping at the first non hex
+// digit. Returns false if no digit was consumed.
+static bool ParseHex(std::string_view s, uint16_t *val) {
+    uint32_t v = 0;
+    size_t i = 0;
+    for (; i < s.size(); i++) {
+        char c = s[i];
+        uint32_t d;
+        if (c >= '0' && c <= '9')
+            d = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            d = c - 'A' + 10;
+        else
+            break;
+        v = (v << 4) | d;
+    }
+    if (i == 0)
+        return false;
+    *val = static_cast<uint16_t>(v);
+    return true;
+}
+
+StorageInfoCache::StorageInfoCache(SysfsReader *reader)
+    : reader_(reader),
+      version_file_(reader->Register(kUFSHealthVersionFile)),
+      health_file_(reader->Register(kUFSHealthFile)),
+      info_{},
+      version_valid_(false),
+      health_valid_(false) {
+    info_.attr.isInternal = true;
+    info_.attr.isBootDevice = true;
+    info_.attr.name = kUFSName;
+}
+
+bool StorageInfoCache::Get(StorageInfo *info) {
+    if (!version_valid_ && !ReadVersion())
+        return false;
+
+    auto now = android::base::boot_clock::now();
+    if (!health_valid_ || now - last_refresh_ >= kRefreshInterval) {
+        if (!ReadHealth())
+            return false;
+        last_refresh_ = now;
+    }
+
+    *info = info_;
+    return true;
+}
+
+bool StorageInfoCache::ReadVersion() {
+    if (!reader_->ReadAll(version_file_, &buffer_))
+        return false;
+
+    size_t pos = buffer_.find(kVersionKey);
+    if (pos == std::string::npos) {
+        LOG(ERROR) << "No UFS version in " << kUFSHealthVersionFile;
+        return false;
+    }
+
+    std::string_view rev(buffer_);
+    rev.remove_prefix(pos + kVersionKey.size());
+    rev = rev.substr(0, std::min(rev.find_first_of(" \n"), kMaxVersionLen));
+    if (rev.empty())
+        return false;
+
+    info_.version = "ufs " + std::string(rev);
+    version_valid_ = true;
+    return true;
+}
+
+bool StorageInfoCache::ReadHealth() {
+    if (!reader_->ReadAll(health_file_, &buffer_))
+        return false;
+
+    ParseHealth(buffer_);
+    health_valid_ = true;
+    return true;
+}
+
+/*
+ * Based on system/core/storaged/storaged_info.cc. Single pass over lines of
+ * the form
+ *   Health Descriptor[Byte offset 0x<n>]: <token> = 0x<value>
+ * without copying the tokens out of the buffer.
+ */
+void StorageInfoCache::ParseHealth(std::string_view desc) {
+    while (!desc.empty()) {
+        size_t eol = desc.find('\n');
+        std::string_view line = desc.substr(0, eol);
+        desc.remove_prefix(eol == std::string_view::npos ? desc.size() : eol + 1);
+
+        size_t start = line.find(kDescSeparator);
+        if (start == std::string_view::npos)
+            continue;
+        line.remove_prefix(start + kDescSeparator.size());
+
+        size_t end = line.find(kValueSeparator);
+        if (end == std::string_view::npos)
+            continue;
+        std::string_view token = line.substr(0, end);
+
+        uint16_t val;
+        if (!ParseHex(line.substr(end + kValueSeparator.size()), &val))
+            continue;
+
+        if (token == "bPreEOLInfo") {
+            info_.eol = val;
+        } else if (token == "bDeviceLifeTimeEstA") {
+            info_.lifetimeA = val;
+        } else if (token == "bDeviceLifeTimeEstB") {
+            info_.lifetimeB = val;
+        }
+    }
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
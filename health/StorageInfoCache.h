@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_STORAGEINFOCACHE_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_STORAGEINFOCACHE_H
+
+#include <android-base/chrono_utils.h>
+#include <android/hardware/health/2.0/types.h>
+#include <string>
+#include <string_view>
+
+#include "SysfsReader.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+using android::hardware::health::V2_0::StorageInfo;
+
+/*
+ * Caches the UFS health descriptor. The version string never changes at
+ * runtime so it is parsed once; the lifetime and EOL fields are refreshed at
+ * most once per kRefreshInterval.
+ */
+class StorageInfoCache {
+  public:
+    StorageInfoCache(SysfsReader *reader);
+    bool Get(StorageInfo *info);
+
+  private:
+    static constexpr std::chrono::minutes kRefreshInterval{60};
+
+    SysfsReader *reader_;
+    SysfsReader::Handle version_file_;
+    SysfsReader::Handle health_file_;
+    StorageInfo info_;
+    bool version_valid_;
+    bool health_valid_;
+    android::base::boot_clock::time_point last_refresh_;
+    std::string buffer_;
+
+    bool ReadVersion();
+    bool ReadHealth();
+    void ParseHealth(std::string_view desc);
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_STORAGEINFOCACHE_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SysfsReader.h"
+#include "HealthPaths.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr size_t kIntBufSize = 32;
+static constexpr size_t kReadChunk = 4096;
+
+SysfsReader::Handle SysfsReader::Register(const char *path, bool writable) {
+    auto entry = std::make_unique<Entry>();
+    entry->path = path;
+    entry->writable = writable;
+    entries_.push_back(std::move(entry));
+    return entries_.size() - 1;
+}
+
+/*
+ * Opens on first use rather than at registration, so files that only appear
+ * later (the /persist backups) are picked up, and a descriptor dropped after
+ * an error is reopened on the next access. Only a write creates a missing
+ * file, so reading a backup that was never saved leaves nothing behind.
+ */
+int SysfsReader::Fd(Entry *e, bool create) {
+    if (e->fd < 0) {
+        std::string path = HealthPath(e->path.c_str());
+        int flags = (e->writable ? O_RDWR : O_RDONLY) | (create ? O_CREAT : 0) | O_CLOEXEC;
+        e->opens++;
+        e->fd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), flags, 0660)));
+        if (e->fd < 0)
+            e->errors++;
+    }
+    return e->fd.get();
+}
+
+void SysfsReader::Fail(Entry *e) {
+    e->errors++;
+    e->fd.reset();
+}
+
+ssize_t SysfsReader::Read(Handle h, char *buf, size_t size) {
+    Entry *e = entries_[h].get();
+    std::lock_guard<std::mutex> lock(e->lock);
+    int fd = Fd(e, false);
+
+    if (fd < 0)
+        return -1;
+
+    e->reads++;
+    ssize_t len = TEMP_FAILURE_RETRY(pread(fd, buf, size - 1, 0));
+    if (len < 0) {
+        Fail(e);
+        return -1;
+    }
+    while (len > 0 && isspace(buf[len - 1]))
+        len--;
+    buf[len] = '\0';
+    return len;
+}
+
+bool SysfsReader::ReadAll(Handle h, std::string *buf) {
+    Entry *e = entries_[h].get();
+    std::lock_guard<std::mutex> lock(e->lock);
+    int fd = Fd(e, false);
+
+    if (fd < 0)
+        return false;
+
+    size_t len = 0;
+    for (;;) {
+        if (buf->size() < len + kReadChunk)
+            buf->resize(len + kReadChunk);
+        e->reads++;
+        ssize_t n = TEMP_FAILURE_RETRY(pread(fd, &(*buf)[len], buf->size() - len, len));
+        if (n < 0) {
+            Fail(e);
+            return false;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+    buf->resize(len);
+    return true;
+}
+
+bool SysfsReader::ReadInt(Handle h, int64_t *val) {
+    char buf[kIntBufSize];
+    char *end;
+
+    if (Read(h, buf, sizeof(buf)) <= 0)
+        return false;
+    int64_t v = strtoll(buf, &end, 10);
+    if (end == buf) {
+        entries_[h]->errors++;
+        return false;
+    }
+    *val = v;
+    return true;
+}
+
+/*
+ * Replaces the contents at offset 0. Sysfs attributes take the whole value
+ * in one write; regular files are truncated to the new length afterwards.
+ */
+bool SysfsReader::Write(Handle h, const char *data, size_t len) {
+    Entry *e = entries_[h].get();
+    std::lock_guard<std::mutex> lock(e->lock);
+    int fd = Fd(e, e->writable);
+
+    if (fd < 0)
+        return false;
+
+    e->writes++;
+    ssize_t n = TEMP_FAILURE_RETRY(pwrite(fd, data, len, 0));
+    if (n != static_cast<ssize_t>(len)) {
+        Fail(e);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > n)
+        TEMP_FAILURE_RETRY(ftruncate(fd, n));
+    return true;
+}
+
+void SysfsReader::Dump(int fd) const {
+    std::string out = android::base::StringPrintf("  %10s %10s %6s %6s  %s\n", "reads", "writes",
+                                                  "opens", "errors", "path");
+
+    for (const auto &e : entries_) {
+        if (!e->opens)
+            continue;
+        android::base::StringAppendF(&out, "  %10" PRIu64 " %10" PRIu64 " %6" PRIu64
+                                     " %6" PRIu64 "  %s\n",
+                                     e->reads.load(), e->writes.load(), e->opens.load(),
+                                     e->errors.load(), e->path.c_str());
+    }
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
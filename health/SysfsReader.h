@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_SYSFSREADER_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_SYSFSREADER_H
+
+#include <android-base/unique_fd.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+/*
+ * Shared access to the sysfs, debugfs, procfs and /persist files of the
+ * health service. Each path is registered once and gets a descriptor that
+ * stays open, so a read is a single pread() into the caller's buffer.
+ * Opens, reads, writes and errors are counted per path for debug().
+ *
+ * Reads and writes may come from any thread; accesses to one path are
+ * serialized so an error on one thread cannot close the descriptor another
+ * is using. Registration is expected to happen while the service starts.
+ */
+class SysfsReader {
+  public:
+    using Handle = size_t;
+
+    Handle Register(const char *path, bool writable = false);
+
+    // Single pread() at offset 0, enough for sysfs attributes. Trailing
+    // whitespace is dropped and the result NUL terminated, so at most
+    // |size| - 1 bytes are read. Returns the length or -1.
+    ssize_t Read(Handle h, char *buf, size_t size);
+    // Reads until EOF into |buf|, reusing its capacity. For debugfs and
+    // procfs files that can exceed one page.
+    bool ReadAll(Handle h, std::string *buf);
+    bool ReadInt(Handle h, int64_t *val);
+    bool Write(Handle h, const char *data, size_t len);
+
+    void Dump(int fd) const;
+
+  private:
+    struct Entry {
+        std::string path;
+        bool writable;
+        android::base::unique_fd fd;
+        std::mutex lock;  // held across every access to fd
+        std::atomic<uint64_t> opens{0};
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> writes{0};
+        std::atomic<uint64_t> errors{0};
+    };
+
+    std::vector<std::unique_ptr<Entry>> entries_;
+
+    // Both called with e->lock held.
+    int Fd(Entry *e, bool create);
+    void Fail(Entry *e);
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_SYSFSREADER_H
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UfsWearTracker.h"
+#include "DiskStatsTracker.h"
+#include "HealthPaths.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+static constexpr char kStatFile[] = "/sys/block/sda/stat";
+static constexpr char kSizeFile[] = "/sys/block/sda/size";
+static constexpr char kTotalFile[] = "/persist/battery/ufs_host_writes";
+static constexpr char kSeriesFile[] = "/persist/battery/ufs_wear";
+static constexpr char kMagic[] = "WUW1";
+static constexpr size_t kMagicLen = sizeof(kMagic) - 1;
+// Daily points for well over a year; older ones are thinned out after that.
+static constexpr size_t kMaxRecords = 512;
+static constexpr std::chrono::hours kUpdateInterval{1};
+static constexpr uint64_t kRecordInterval = 24 * 3600;
+static constexpr uint64_t kRateWindow = 30 * 24 * 3600;
+static constexpr uint64_t kSectorSize = 512;
+static constexpr int kBufSize = 256;
+
+// Rated program/erase cycles of the NAND, used to turn capacity into the
+// endurance that each 10% lifetime bucket stands for.
+static constexpr char kPeCyclesProp[] = "persist.vendor.health.ufs_pe_cycles";
+static constexpr uint32_t kDefaultPeCycles = 3000;
+
+// JEDEC lifetime estimates: 0x01 is 0-10% used ... 0x0A is 90-100% used,
+// 0x0B means the rated lifetime is exceeded and 0x00 that it is unknown.
+static constexpr uint8_t kLifetimeLastBucket = 0x0A;
+static constexpr uint8_t kLifetimeExceeded = 0x0B;
+static constexpr int kLifetimeBuckets = 10;
+static constexpr double kWarnDays = 3 * 365;
+
+// The worse of the two estimates, or 0 if neither is known.
+static uint8_t Lifetime(const UfsWearRecord &rec) {
+    uint8_t a = rec.lifetime_a <= kLifetimeExceeded ? rec.lifetime_a : 0;
+    uint8_t b = rec.lifetime_b <= kLifetimeExceeded ? rec.lifetime_b : 0;
+    return std::max(a, b);
+}
+
+static bool SameWear(const UfsWearRecord &a, const UfsWearRecord &b) {
+    return a.lifetime_a == b.lifetime_a && a.lifetime_b == b.lifetime_b && a.eol == b.eol;
+}
+
+// Wall clock time at which the current boot started, to tell a restart of
+// the service from a reboot.
+static int64_t BootEpoch() {
+    return time(nullptr) - std::chrono::duration_cast<std::chrono::seconds>(
+                               android::base::boot_clock::now().time_since_epoch())
+                               .count();
+}
+
+UfsWearTracker::UfsWearTracker(SysfsReader *reader)
+    : reader_(reader),
+      stat_file_(reader->Register(kStatFile)),
+      size_file_(reader->Register(kSizeFile)),
+      total_file_(reader->Register(kTotalFile, true)),
+      cur_{},
+      base_sectors_(0),
+      last_counter_(0),
+      capacity_bytes_(0),
+      have_sample_(false) {}
+
+void UfsWearTracker::Restore() {
+    std::string data;
+    char buf[kBufSize];
+
+    if (android::base::ReadFileToString(HealthPath(kSeriesFile), &data)) {
+        if (data.size() < kMagicLen || data.compare(0, kMagicLen, kMagic) != 0 ||
+            (data.size() - kMagicLen) % sizeof(UfsWearRecord) != 0) {
+            LOG(ERROR) << kSeriesFile << ": unexpected format, ignoring";
+        } else {
+            series_.resize((data.size() - kMagicLen) / sizeof(UfsWearRecord));
+            memcpy(series_.data(), data.data() + kMagicLen,
+                   series_.size() * sizeof(UfsWearRecord));
+        }
+    }
+
+    if (reader_->Read(size_file_, buf, sizeof(buf)) > 0)
+        capacity_bytes_ = strtoull(buf, nullptr, 10) * kSectorSize;
+
+    uint64_t saved_total = 0, saved_counter = 0, counter = 0;
+    int64_t saved_epoch = 0;
+    if (reader_->Read(total_file_, buf, sizeof(buf)) > 0 &&
+        sscanf(buf, "%" SCNu64 " %" SCNu64 " %" SCNd64, &saved_total, &saved_counter,
+               &saved_epoch) == 3) {
+        // Same boot as the saved total: it already includes the counter as
+        // it was then, so only what was written since then is added.
+        if (ReadCounter(&counter) && counter >= saved_counter &&
+            llabs(saved_epoch - BootEpoch()) < 60)
+            base_sectors_ = saved_total - saved_counter;
+        else
+            base_sectors_ = saved_total;
+    } else if (!series_.empty()) {
+        base_sectors_ = series_.back().host_sectors;
+    }
+}
+
+bool UfsWearTracker::ReadCounter(uint64_t *sectors) {
+    char buf[kBufSize];
+    DiskStats stats;
+
+    ssize_t len = reader_->Read(stat_file_, buf, sizeof(buf));
+    if (len <= 0 || !ParseDiskStats(buf, len, &stats))
+        return false;
+    *sectors = stats.writeSectors;
+    return true;
+}
+
+void UfsWearTracker::SaveTotal(uint64_t counter) {
+    char buf[kBufSize];
+
+    int len = snprintf(buf, sizeof(buf), "%" PRIu64 " %" PRIu64 " %" PRId64, cur_.host_sectors,
+                       counter, static_cast<int64_t>(BootEpoch()));
+    if (!reader_->Write(total_file_, buf, len))
+        PLOG(ERROR) << kTotalFile << ": write failed";
+}
+
+void UfsWearTracker::Update(const StorageInfo &info) {
+    auto now = android::base::boot_clock::now();
+    uint64_t counter;
+
+    if (have_sample_ && now - last_update_ < kUpdateInterval)
+        return;
+    if (!ReadCounter(&counter))
+        return;
+    last_update_ = now;
+    have_sample_ = true;
+
+    // The counter only goes back when the LUN is re-registered.
+    if (counter < last_counter_)
+        base_sectors_ += last_counter_;
+    last_counter_ = counter;
+
+    cur_.timestamp = time(nullptr);
+    cur_.host_sectors = base_sectors_ + counter;
+    cur_.lifetime_a = info.lifetimeA;
+    cur_.lifetime_b = info.lifetimeB;
+    cur_.eol = info.eol;
+    SaveTotal(counter);
+
+    if (series_.empty() || !SameWear(series_.back(), cur_) ||
+        cur_.timestamp - series_.back().timestamp >= kRecordInterval)
+        Append();
+}
+
+/*
+ * When the series is full every other point of its older half is dropped,
+ * except the ones where the wear changed: the bucket transitions are kept
+ * for as long as the file exists.
+ */
+void UfsWearTracker::Append() {
+    series_.push_back(cur_);
+
+    if (series_.size() > kMaxRecords) {
+        std::vector<UfsWearRecord> thinned;
+        size_t half = series_.size() / 2;
+        for (size_t i = 0; i < series_.size(); i++) {
+            if (i >= half || i == 0 || i % 2 == 0 || !SameWear(series_[i], series_[i - 1]))
+                thinned.push_back(series_[i]);
+        }
+        series_.swap(thinned);
+    }
+
+    std::string data(kMagic, kMagicLen);
+    data.append(reinterpret_cast<const char *>(series_.data()),
+                series_.size() * sizeof(UfsWearRecord));
+    if (!android::base::WriteStringToFile(data, HealthPath(kSeriesFile)))
+        PLOG(ERROR) << kSeriesFile << ": write failed";
+}
+
+static double GiB(uint64_t sectors) {
+    return sectors * kSectorSize / (1024.0 * 1024 * 1024);
+}
+
+static std::string Date(uint64_t timestamp) {
+    char when[32];
+    time_t t = timestamp;
+    strftime(when, sizeof(when), "%Y-%m-%d", gmtime(&t));
+    return when;
+}
+
+/*
+ * Each lifetime bucket stands for a tenth of the rated endurance, i.e.
+ * capacity x P/E cycles of NAND writes. Once a whole bucket has been seen,
+ * the host writes it took give the write amplification and the expected
+ * size of the next bucket; before that the rated endurance is used at a
+ * write amplification of 1, which overestimates the time left.
+ */
+void UfsWearTracker::Dump(int fd) const {
+    std::string out;
+
+    if (!have_sample_) {
+        android::base::WriteStringToFd("  no samples yet\n", fd);
+        return;
+    }
+
+    uint8_t level = Lifetime(cur_);
+    android::base::StringAppendF(&out,
+                                 "  lifetime A 0x%02x B 0x%02x pre-EOL 0x%02x, host writes "
+                                 "%.1f GiB\n",
+                                 cur_.lifetime_a, cur_.lifetime_b, cur_.eol,
+                                 GiB(cur_.host_sectors));
+
+    // Entry into the current bucket and into the one before it.
+    const UfsWearRecord *entered = nullptr, *prev_entered = nullptr;
+    for (size_t i = 1; i < series_.size(); i++) {
+        uint8_t from = Lifetime(series_[i - 1]), to = Lifetime(series_[i]);
+        if (from && to > from) {
+            prev_entered = entered;
+            entered = &series_[i];
+        }
+        if (from != to)
+            android::base::StringAppendF(&out, "  %s bucket 0x%02x -> 0x%02x at %.1f GiB\n",
+                                         Date(series_[i].timestamp).c_str(), from, to,
+                                         GiB(series_[i].host_sectors));
+    }
+
+    // Host write rate over the last kRateWindow.
+    const UfsWearRecord *since = nullptr;
+    for (const auto &rec : series_) {
+        if (rec.timestamp + kRateWindow >= cur_.timestamp) {
+            since = &rec;
+            break;
+        }
+    }
+    double rate = 0;
+    if (since && cur_.timestamp - since->timestamp >= kRecordInterval)
+        rate = (cur_.host_sectors - since->host_sectors) * kSectorSize /
+               ((cur_.timestamp - since->timestamp) / 86400.0);
+    if (rate > 0)
+        android::base::StringAppendF(&out, "  write rate %.2f GiB/day over %.0f days\n",
+                                     rate / (1024.0 * 1024 * 1024),
+                                     (cur_.timestamp - since->timestamp) / 86400.0);
+    else
+        out += "  write rate n/a (less than a day of data)\n";
+
+    uint32_t pe_cycles = android::base::GetUintProperty<uint32_t>(kPeCyclesProp,
+                                                                  kDefaultPeCycles);
+    double bucket_nand = static_cast<double>(capacity_bytes_) * pe_cycles / kLifetimeBuckets;
+    double bucket_host = bucket_nand;
+    if (entered && prev_entered) {
+        bucket_host = (entered->host_sectors - prev_entered->host_sectors) * kSectorSize;
+        android::base::StringAppendF(&out,
+                                     "  write amplification %.2f (bucket 0x%02x took %.1f GiB "
+                                     "of host writes, %u P/E cycles assumed)\n",
+                                     bucket_host > 0 ? bucket_nand / bucket_host : 0,
+                                     Lifetime(*prev_entered), bucket_host / (1024.0 * 1024 * 1024),
+                                     pe_cycles);
+    } else {
+        out += "  write amplification n/a (no complete bucket observed)\n";
+    }
+
+    if (level == 0) {
+        out += "  lifetime not reported\n";
+    } else if (level >= kLifetimeExceeded) {
+        out += "  WARNING: rated lifetime exceeded\n";
+    } else if (rate > 0 && bucket_host > 0) {
+        double written = entered ? (cur_.host_sectors - entered->host_sectors) * kSectorSize : 0;
+        double next_days = std::max(bucket_host - written, 0.0) / rate;
+        double eol_days = next_days + (kLifetimeLastBucket - level) * bucket_host / rate;
+        android::base::StringAppendF(&out, "  days to next bucket %.0f%s, to rated EOL %.0f\n",
+                                     next_days, entered && prev_entered ? "" : " (upper bound)",
+                                     eol_days);
+        if (eol_days < kWarnDays)
+            out += "  WARNING: projected to reach rated EOL within 3 years\n";
+    }
+
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_UFSWEARTRACKER_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_UFSWEARTRACKER_H
+
+#include <android-base/chrono_utils.h>
+#include <android/hardware/health/2.0/types.h>
+#include <vector>
+
+#include "SysfsReader.h"
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+using android::hardware::health::V2_0::StorageInfo;
+
+// One point of the persisted wear series.
+struct UfsWearRecord {
+    uint64_t timestamp;      // seconds since the epoch
+    uint64_t host_sectors;   // cumulative across reboots
+    uint8_t lifetime_a;      // bDeviceLifeTimeEstA
+    uint8_t lifetime_b;      // bDeviceLifeTimeEstB
+    uint8_t eol;             // bPreEOLInfo
+    uint8_t reserved[5];
+};
+static_assert(sizeof(UfsWearRecord) == 24, "UfsWearRecord layout changed");
+
+/*
+ * Follows UFS wear against the amount of data written by the host. The
+ * write counter of the userdata LUN restarts at every boot, so the running
+ * total is kept in /persist together with the boot it was taken in. A point
+ * is added to the series once a day and whenever a lifetime estimate or the
+ * pre-EOL state changes; the bucket transitions are what the write
+ * amplification and days-to-next-bucket estimates are derived from.
+ */
+class UfsWearTracker {
+  public:
+    UfsWearTracker(SysfsReader *reader);
+    void Restore();
+    void Update(const StorageInfo &info);
+    void Dump(int fd) const;
+
+  private:
+    SysfsReader *reader_;
+    SysfsReader::Handle stat_file_;
+    SysfsReader::Handle size_file_;
+    SysfsReader::Handle total_file_;
+    std::vector<UfsWearRecord> series_;
+    UfsWearRecord cur_;
+    uint64_t base_sectors_;
+    uint64_t last_counter_;
+    uint64_t capacity_bytes_;
+    bool have_sample_;
+    android::base::boot_clock::time_point last_update_;
+
+    bool ReadCounter(uint64_t *sectors);
+    void SaveTotal(uint64_t counter);
+    void Append();
+};
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_UFSWEARTRACKER_H
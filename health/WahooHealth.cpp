@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "android.hardware.health@2.0-service.wahoo"
+#include <android-base/logging.h>
+
+#include "WahooHealth.h"
+
+#include <hal_conversion.h>
+#include <health2/Health.h>
+#include <healthd/healthd.h>
+#include <hidl/HidlTransportSupport.h>
+#include <hwbinder/IPCThreadState.h>
+
+#include <unistd.h>
+
+using android::hardware::IPCThreadState;
+using android::hardware::handleTransportPoll;
+using android::hardware::setupTransportPolling;
+using android::hardware::Void;
+using android::hardware::health::V1_0::hal_conversion::convertToHealthInfo;
+using android::hardware::health::V2_0::HealthInfo;
+using android::hardware::health::V2_0::implementation::Health;
+
+extern int healthd_main(void);
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+WahooHealth::WahooHealth(const sp<IHealth> &impl, DebugDumpFunc dump)
+    : impl_(impl), dump_(std::move(dump)) {}
+
+Return<Result> WahooHealth::registerCallback(const sp<IHealthInfoCallback> &callback) {
+    return impl_->registerCallback(callback);
+}
+
+Return<Result> WahooHealth::unregisterCallback(const sp<IHealthInfoCallback> &callback) {
+    return impl_->unregisterCallback(callback);
+}
+
+Return<Result> WahooHealth::update() {
+    return impl_->update();
+}
+
+Return<void> WahooHealth::getChargeCounter(getChargeCounter_cb _hidl_cb) {
+    return impl_->getChargeCounter(_hidl_cb);
+}
+
+Return<void> WahooHealth::getCurrentNow(getCurrentNow_cb _hidl_cb) {
+    return impl_->getCurrentNow(_hidl_cb);
+}
+
+Return<void> WahooHealth::getCurrentAverage(getCurrentAverage_cb _hidl_cb) {
+    return impl_->getCurrentAverage(_hidl_cb);
+}
+
+Return<void> WahooHealth::getCapacity(getCapacity_cb _hidl_cb) {
+    return impl_->getCapacity(_hidl_cb);
+}
+
+Return<void> WahooHealth::getEnergyCounter(getEnergyCounter_cb _hidl_cb) {
+    return impl_->getEnergyCounter(_hidl_cb);
+}
+
+Return<void> WahooHealth::getChargeStatus(getChargeStatus_cb _hidl_cb) {
+    return impl_->getChargeStatus(_hidl_cb);
+}
+
+Return<void> WahooHealth::getStorageInfo(getStorageInfo_cb _hidl_cb) {
+    return impl_->getStorageInfo(_hidl_cb);
+}
+
+Return<void> WahooHealth::getDiskStats(getDiskStats_cb _hidl_cb) {
+    return impl_->getDiskStats(_hidl_cb);
+}
+
+Return<void> WahooHealth::getHealthInfo(getHealthInfo_cb _hidl_cb) {
+    return impl_->getHealthInfo(_hidl_cb);
+}
+
+Return<void> WahooHealth::debug(const hidl_handle &handle, const hidl_vec<hidl_string> &args) {
+    // The default dump ignores arguments; with arguments the caller is asking
+    // for one specific wahoo dump, which may be binary.
+    if (args.size() == 0)
+        impl_->debug(handle, args);
+
+    if (handle != nullptr && handle->numFds >= 1) {
+        int fd = handle->data[0];
+        dump_(fd, args);
+        fsync(fd);
+    }
+    return Void();
+}
+
+/*
+ * The healthd mode below mirrors the one in libhealthservice
+ * (hardware/interfaces/health/2.0/utils/libhealthservice), except that the
+ * registered service is the WahooHealth wrapper.
+ */
+static int gBinderFd = -1;
+static DebugDumpFunc gDebugDump;
+
+static void binder_event(uint32_t /*epevents*/) {
+    if (gBinderFd >= 0)
+        handleTransportPoll(gBinderFd);
+}
+
+static void wahoo_health_mode_init(struct healthd_config *config) {
+    LOG(INFO) << "Hal is starting up...";
+
+    gBinderFd = setupTransportPolling();
+
+    if (gBinderFd >= 0) {
+        if (healthd_register_event(gBinderFd, binder_event))
+            LOG(ERROR) << "Register for binder events failed";
+    }
+
+    sp<IHealth> service = new WahooHealth(Health::initInstance(config), gDebugDump);
+    CHECK_EQ(service->registerAsService(), android::OK) << "Failed to register HAL";
+
+    LOG(INFO) << "Hal init done";
+}
+
+static int wahoo_health_mode_preparetowait(void) {
+    IPCThreadState::self()->flushCommands();
+    return -1;
+}
+
+static void wahoo_health_mode_heartbeat(void) {}
+
+static void wahoo_health_mode_battery_update(struct android::BatteryProperties *prop) {
+    HealthInfo info;
+    convertToHealthInfo(prop, info.legacy);
+    Health::getImplementation()->notifyListeners(&info);
+}
+
+static struct healthd_mode_ops wahoo_health_mode_ops = {
+    .init = wahoo_health_mode_init,
+    .preparetowait = wahoo_health_mode_preparetowait,
+    .heartbeat = wahoo_health_mode_heartbeat,
+    .battery_update = wahoo_health_mode_battery_update,
+};
+
+int wahoo_health_service_main(DebugDumpFunc dump) {
+    gDebugDump = std::move(dump);
+    healthd_mode_ops = &wahoo_health_mode_ops;
+    LOG(INFO) << "Hal starting main loop...";
+    return healthd_main();
+}
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
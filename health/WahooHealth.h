@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_GOOGLE_WAHOO_HEALTH_WAHOOHEALTH_H
+#define DEVICE_GOOGLE_WAHOO_HEALTH_WAHOOHEALTH_H
+
+#include <android/hardware/health/2.0/IHealth.h>
+#include <functional>
+
+namespace device {
+namespace google {
+namespace wahoo {
+namespace health {
+
+using android::sp;
+using android::hardware::hidl_handle;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Return;
+using android::hardware::health::V2_0::IHealth;
+using android::hardware::health::V2_0::IHealthInfoCallback;
+using android::hardware::health::V2_0::Result;
+
+using DebugDumpFunc = std::function<void(int fd, const hidl_vec<hidl_string> &args)>;
+
+/*
+ * Forwards every IHealth call to the default implementation and appends the
+ * wahoo specific state to the output of debug(). When debug() is given
+ * arguments only |dump| runs, so it can emit a single section on its own.
+ */
+class WahooHealth : public IHealth {
+  public:
+    WahooHealth(const sp<IHealth> &impl, DebugDumpFunc dump);
+
+    Return<Result> registerCallback(const sp<IHealthInfoCallback> &callback) override;
+    Return<Result> unregisterCallback(const sp<IHealthInfoCallback> &callback) override;
+    Return<Result> update() override;
+    Return<void> getChargeCounter(getChargeCounter_cb _hidl_cb) override;
+    Return<void> getCurrentNow(getCurrentNow_cb _hidl_cb) override;
+    Return<void> getCurrentAverage(getCurrentAverage_cb _hidl_cb) override;
+    Return<void> getCapacity(getCapacity_cb _hidl_cb) override;
+    Return<void> getEnergyCounter(getEnergyCounter_cb _hidl_cb) override;
+    Return<void> getChargeStatus(getChargeStatus_cb _hidl_cb) override;
+    Return<void> getStorageInfo(getStorageInfo_cb _hidl_cb) override;
+    Return<void> getDiskStats(getDiskStats_cb _hidl_cb) override;
+    Return<void> getHealthInfo(getHealthInfo_cb _hidl_cb) override;
+
+    Return<void> debug(const hidl_handle &handle, const hidl_vec<hidl_string> &args) override;
+
+  private:
+    const sp<IHealth> impl_;
+    const DebugDumpFunc dump_;
+};
+
+// Same as health_service_main(), but registers a WahooHealth around the
+// default implementation so |dump| is reachable through lshal debug.
+int wahoo_health_service_main(DebugDumpFunc dump);
+
+}  // namespace health
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+
+#endif  // #ifndef DEVICE_GOOGLE_WAHOO_HEALTH_WAHOOHEALTH_H
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "coolingdevicestateresidency"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <cutils/uevent.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/filter.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include "CoolingDeviceStateResidencyDataProvider.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static const char kCoolingDevicePrefix[] = "cooling_device";
+static const size_t kUeventMsgLen = 2048;
+// Cooling devices and thermal zones both live here. The length is a
+// multiple of 4 so the filter can compare whole words.
+static const char kThermalUeventPrefix[] = "change@/devices/virtual/thermal/";
+
+static uint64_t bootTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+CoolingDeviceStateResidencyDataProvider::CoolingDeviceStateResidencyDataProvider(
+        const std::string &thermalRoot, std::chrono::milliseconds pollInterval)
+    : mPollInterval(pollInterval) {
+    // Sort by device number so entity registration is stable across boots.
+    std::map<uint32_t, std::string> dirs;
+    DIR *dir = opendir(thermalRoot.c_str());
+    if (!dir) {
+        PLOG(ERROR) << __func__ << ":Failed to open " << thermalRoot;
+        return;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+        uint32_t index;
+        if (!strncmp(entry->d_name, kCoolingDevicePrefix, strlen(kCoolingDevicePrefix)) &&
+                android::base::ParseUint(entry->d_name + strlen(kCoolingDevicePrefix), &index)) {
+            dirs[index] = thermalRoot + "/" + entry->d_name;
+        }
+    }
+    closedir(dir);
+
+    std::map<std::string, int> names;
+    for (const auto &d : dirs) {
+        std::string type, maxState;
+        uint32_t max;
+        if (!android::base::ReadFileToString(d.second + "/type", &type) ||
+                !android::base::ReadFileToString(d.second + "/max_state", &maxState) ||
+                !android::base::ParseUint(android::base::Trim(maxState), &max)) {
+            LOG(ERROR) << __func__ << ":Failed to read " << d.second;
+            continue;
+        }
+        if (max >= kMaxStates) {
+            LOG(INFO) << __func__ << ":Skipping " << d.second << " with " << max + 1 << " states";
+            continue;
+        }
+
+        // Several devices can share a type, e.g. one per CPU.
+        std::string name = android::base::Trim(type);
+        if (names[name]++) {
+            name += "-" + std::to_string(names[name] - 1);
+        }
+        Device device = {.name = name, .curStatePath = d.second + "/cur_state",
+                         .registered = false, .stateCount = max + 1,
+                         .currentState = max + 1};
+        device.curStateFd.reset(TEMP_FAILURE_RETRY(
+                open(device.curStatePath.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (device.curStateFd < 0) {
+            PLOG(ERROR) << __func__ << ":Failed to open " << device.curStatePath;
+            continue;
+        }
+        device.totalTimeMs.resize(device.stateCount);
+        device.entryCount.resize(device.stateCount);
+        device.lastEntryMs.resize(device.stateCount);
+        mDevices.push_back(std::move(device));
+    }
+}
+
+CoolingDeviceStateResidencyDataProvider::~CoolingDeviceStateResidencyDataProvider() {
+    if (mWatcher.joinable()) {
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd, &one, sizeof(one)));
+        mWatcher.join();
+    }
+}
+
+void CoolingDeviceStateResidencyDataProvider::setPowerEntityId(size_t device, uint32_t id) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mDevices[device].powerEntityId = id;
+    mDevices[device].registered = true;
+}
+
+// Drops every uevent not starting with kThermalUeventPrefix in the kernel,
+// so the watcher is not woken by the uevents of other subsystems.
+static bool attachThermalFilter(int fd) {
+    static_assert((sizeof(kThermalUeventPrefix) - 1) % 4 == 0, "prefix must be whole words");
+    const uint32_t words = (sizeof(kThermalUeventPrefix) - 1) / 4;
+    const auto *p = reinterpret_cast<const uint8_t *>(kThermalUeventPrefix);
+    std::vector<struct sock_filter> code;
+    for (uint32_t i = 0; i < words; i++) {
+        // Absolute loads are big endian.
+        uint32_t word = p[4 * i] << 24 | p[4 * i + 1] << 16 | p[4 * i + 2] << 8 | p[4 * i + 3];
+        code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 4 * i));
+        // On mismatch, jump to the final reject.
+        uint8_t reject = 2 * (words - i) - 1;
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, word, 0, reject));
+    }
+    code.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+    code.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+
+    struct sock_fprog prog = {.len = static_cast<unsigned short>(code.size()),
+                              .filter = code.data()};
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == 0;
+}
+
+void CoolingDeviceStateResidencyDataProvider::start() {
+    if (mDevices.empty() || mWatcher.joinable()) {
+        return;
+    }
+
+    mStopFd.reset(eventfd(0, EFD_CLOEXEC));
+    if (mStopFd < 0) {
+        PLOG(ERROR) << __func__ << ":Failed to create eventfd, sampling on demand only";
+        return;
+    }
+    // Without uevents the watcher only samples once per poll interval.
+    mUeventFd.reset(uevent_open_socket(64 * 1024, true));
+    if (mUeventFd < 0) {
+        PLOG(ERROR) << __func__ << ":Failed to open uevent socket, sampling every "
+                    << mPollInterval.count() << " ms only";
+    } else {
+        fcntl(mUeventFd, F_SETFL, O_NONBLOCK);
+        if (!attachThermalFilter(mUeventFd)) {
+            PLOG(WARNING) << __func__ << ":Failed to attach uevent filter";
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        sampleLocked(bootTimeMs());
+    }
+    mWatcher = std::thread(&CoolingDeviceStateResidencyDataProvider::watcherLoop, this);
+}
+
+void CoolingDeviceStateResidencyDataProvider::sampleLocked(uint64_t nowMs) {
+    for (auto &device : mDevices) {
+        char buf[16] = {};
+        ssize_t len = TEMP_FAILURE_RETRY(pread(device.curStateFd, buf, sizeof(buf) - 1, 0));
+        if (len <= 0) {
+            continue;
+        }
+        uint32_t state = strtoul(buf, nullptr, 10);
+        if (state >= device.stateCount || state == device.currentState) {
+            continue;
+        }
+
+        uint32_t current = device.currentState;
+        if (current < device.stateCount) {
+            device.totalTimeMs[current] += nowMs - device.lastEntryMs[current];
+        }
+        device.entryCount[state]++;
+        device.lastEntryMs[state] = nowMs;
+        device.currentState = state;
+    }
+}
+
+void CoolingDeviceStateResidencyDataProvider::watcherLoop() {
+    struct pollfd fds[] = {
+        {.fd = mUeventFd, .events = POLLIN},
+        {.fd = mStopFd, .events = POLLIN},
+    };
+    // Uevents only bring the next sample forward; the timer stays armed for
+    // cooling devices that change state without one.
+    auto next = std::chrono::steady_clock::now() + mPollInterval;
+
+    while (true) {
+        int timeout = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                next - std::chrono::steady_clock::now()).count(), 0);
+        int ret = poll(fds, 2, timeout);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << __func__ << ":poll failed, sampling on demand only";
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        bool thermalEvent = false;
+        if (fds[0].revents & POLLIN) {
+            char msg[kUeventMsgLen + 2];
+            ssize_t n;
+            while ((n = uevent_kernel_multicast_recv(mUeventFd, msg, kUeventMsgLen)) > 0) {
+                if (n >= static_cast<ssize_t>(kUeventMsgLen)) {
+                    continue;
+                }
+                msg[n] = '\0';
+                msg[n + 1] = '\0';
+                for (char *cp = msg; *cp; cp += strlen(cp) + 1) {
+                    if (!strcmp(cp, "SUBSYSTEM=thermal")) {
+                        thermalEvent = true;
+                    }
+                }
+            }
+        }
+
+        if (thermalEvent || std::chrono::steady_clock::now() >= next) {
+            std::lock_guard<std::mutex> lock(mLock);
+            sampleLocked(bootTimeMs());
+            next = std::chrono::steady_clock::now() + mPollInterval;
+        }
+    }
+}
+
+bool CoolingDeviceStateResidencyDataProvider::getResults(
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
+    std::lock_guard<std::mutex> lock(mLock);
+    uint64_t nowMs = bootTimeMs();
+    sampleLocked(nowMs);
+
+    for (const auto &device : mDevices) {
+        if (!device.registered || device.currentState >= device.stateCount) {
+            continue;
+        }
+        PowerEntityStateResidencyResult result = {.powerEntityId = device.powerEntityId};
+        result.stateResidencyData.resize(device.stateCount);
+        for (uint32_t i = 0; i < device.stateCount; i++) {
+            uint64_t totalTimeMs = device.totalTimeMs[i];
+            if (i == device.currentState) {
+                totalTimeMs += nowMs - device.lastEntryMs[i];
+            }
+            result.stateResidencyData[i] = {.powerEntityStateId = i,
+                                            .totalTimeInStateMs = totalTimeMs,
+                                            .totalStateEntryCount = device.entryCount[i],
+                                            .lastEntryTimestampMs = device.lastEntryMs[i]};
+        }
+        results.emplace(device.powerEntityId, result);
+    }
+    return true;
+}
+
+std::vector<PowerEntityStateSpace> CoolingDeviceStateResidencyDataProvider::getStateSpaces() {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::vector<PowerEntityStateSpace> stateSpaces;
+
+    for (const auto &device : mDevices) {
+        if (!device.registered) {
+            continue;
+        }
+        PowerEntityStateSpace space = {.powerEntityId = device.powerEntityId};
+        space.states.resize(device.stateCount);
+        for (uint32_t i = 0; i < device.stateCount; i++) {
+            space.states[i] = {.powerEntityStateId = i,
+                               .powerEntityStateName = "state" + std::to_string(i)};
+        }
+        stateSpaces.push_back(space);
+    }
+    return stateSpaces;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_COOLINGDEVICESTATERESIDENCYDATAPROVIDER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_COOLINGDEVICESTATERESIDENCYDATAPROVIDER_H
+
+#include <android-base/unique_fd.h>
+#include <pixelpowerstats/PowerStats.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Tracks how long each thermal cooling device spends at each cur_state, so
+ * throttling under real load can be quantified. A watcher thread re-reads
+ * every cur_state once per poll interval, and early when a thermal uevent
+ * arrives; a socket filter keeps the uevents of other subsystems from
+ * waking it. Cooling devices that change state without a uevent are thus
+ * timestamped within a poll interval. Transitions are timestamped with
+ * CLOCK_BOOTTIME, and getResults() adds the time spent so far in the
+ * current state.
+ */
+class CoolingDeviceStateResidencyDataProvider : public IStateResidencyDataProvider {
+  public:
+    // Discovers the cooling devices under |thermalRoot|, normally
+    // /sys/class/thermal. Devices with more than kMaxStates states are
+    // skipped.
+    CoolingDeviceStateResidencyDataProvider(const std::string &thermalRoot,
+                                            std::chrono::milliseconds pollInterval);
+    ~CoolingDeviceStateResidencyDataProvider();
+    size_t deviceCount() const { return mDevices.size(); }
+    const std::string &deviceName(size_t device) const { return mDevices[device].name; }
+    void setPowerEntityId(size_t device, uint32_t id);
+    // Starts the watcher; call once all devices have their entity ids.
+    void start();
+
+    bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult>
+            &results) override;
+    std::vector<PowerEntityStateSpace> getStateSpaces() override;
+
+    static constexpr uint32_t kMaxStates = 32;
+
+  private:
+    struct Device {
+        std::string name;
+        std::string curStatePath;
+        android::base::unique_fd curStateFd;
+        uint32_t powerEntityId;
+        bool registered;
+        uint32_t stateCount;
+        uint32_t currentState;  // stateCount until the first read
+        std::vector<uint64_t> totalTimeMs;
+        std::vector<uint64_t> entryCount;
+        std::vector<uint64_t> lastEntryMs;
+    };
+
+    void sampleLocked(uint64_t nowMs);
+    void watcherLoop();
+
+    const std::chrono::milliseconds mPollInterval;
+    std::mutex mLock;
+    std::vector<Device> mDevices;
+    android::base::unique_fd mUeventFd;
+    android::base::unique_fd mStopFd;
+    std::thread mWatcher;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_COOLINGDEVICESTATERESIDENCYDATAPROVIDER_H
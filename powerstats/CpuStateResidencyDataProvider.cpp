@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "cpustateresidency"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "CpuStateResidencyDataProvider.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static const int kMaxCpus = 32;
+// time_in_state is in USER_HZ ticks.
+static const uint64_t kMsPerTick = 10;
+
+CpuStateResidencyDataProvider::CpuStateResidencyDataProvider(const std::string &cpuRoot) {
+    for (int policy = 0; policy < kMaxCpus; policy++) {
+        std::string policyDir = cpuRoot + "/cpufreq/policy" + std::to_string(policy);
+        std::string related;
+        if (!android::base::ReadFileToString(policyDir + "/related_cpus", &related)) {
+            continue;
+        }
+        std::vector<int> cpus;
+        for (const auto &token : android::base::Split(android::base::Trim(related), " ")) {
+            int cpu;
+            if (android::base::ParseInt(token, &cpu, 0, kMaxCpus - 1)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (cpus.empty()) {
+            LOG(ERROR) << __func__ << ":No CPUs in " << policyDir;
+            continue;
+        }
+
+        Cluster cluster = {.cpuCount = cpus.size()};
+
+        // The state names are the same on every CPU of a cluster.
+        for (int state = 0;; state++) {
+            std::string stateDir = "/cpuidle/state" + std::to_string(state);
+            std::string name;
+            if (!android::base::ReadFileToString(cpuRoot + "/cpu" + std::to_string(cpus[0]) +
+                                                 stateDir + "/name", &name)) {
+                break;
+            }
+            IdleState idle = {.name = android::base::Trim(name)};
+            for (int cpu : cpus) {
+                std::string dir = cpuRoot + "/cpu" + std::to_string(cpu) + stateDir;
+                idle.timeUs.push_back({.path = dir + "/time", .last = 0});
+                idle.usage.push_back({.path = dir + "/usage", .last = 0});
+            }
+            cluster.idleStates.push_back(std::move(idle));
+        }
+
+        cluster.timeInState.path = policyDir + "/stats/time_in_state";
+        cluster.timeInState.last = 0;
+        std::string timeInState;
+        if (android::base::ReadFileToString(cluster.timeInState.path, &timeInState)) {
+            for (const auto &line : android::base::Split(timeInState, "\n")) {
+                uint64_t khz;
+                if (android::base::ParseUint(android::base::Split(line, " ")[0], &khz)) {
+                    cluster.freqsKhz.push_back(khz);
+                }
+            }
+        }
+        cluster.freqTimeMs.resize(cluster.freqsKhz.size());
+
+        std::string name = "CPUCL" + std::to_string(mClusters.size());
+        if (!cluster.idleStates.empty()) {
+            mEntities.push_back({.name = name + "_IDLE", .cluster = mClusters.size(),
+                                 .kind = Kind::IDLE, .registered = false});
+        }
+        if (!cluster.freqsKhz.empty()) {
+            mEntities.push_back({.name = name + "_FREQ", .cluster = mClusters.size(),
+                                 .kind = Kind::FREQ, .registered = false});
+        }
+        mClusters.push_back(std::move(cluster));
+    }
+}
+
+void CpuStateResidencyDataProvider::setPowerEntityId(size_t entity, uint32_t id) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntities[entity].powerEntityId = id;
+    mEntities[entity].registered = true;
+}
+
+ssize_t CpuStateResidencyDataProvider::readFile(CounterFile *file, char *buf, size_t size) {
+    if (file->fd < 0) {
+        file->fd.reset(TEMP_FAILURE_RETRY(open(file->path.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (file->fd < 0) {
+            return -1;
+        }
+    }
+    ssize_t len = TEMP_FAILURE_RETRY(pread(file->fd, buf, size - 1, 0));
+    if (len <= 0) {
+        // Offline CPUs lose their cpuidle nodes; reopen on the next call.
+        file->fd.reset();
+        return -1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+uint64_t CpuStateResidencyDataProvider::readCounter(CounterFile *file) {
+    char buf[32];
+    if (readFile(file, buf, sizeof(buf)) > 0) {
+        file->last = strtoull(buf, nullptr, 10);
+    }
+    return file->last;
+}
+
+void CpuStateResidencyDataProvider::readTimeInState(Cluster *cluster) {
+    char buf[4096];
+    if (readFile(&cluster->timeInState, buf, sizeof(buf)) <= 0) {
+        return;
+    }
+
+    // The frequencies come in the same order on every read.
+    char *p = buf;
+    for (size_t i = 0; *p != '\0'; i++) {
+        char *end;
+        uint64_t khz = strtoull(p, &end, 10);
+        uint64_t ticks = strtoull(end, &end, 10);
+        if (end == p) {
+            break;
+        }
+        if (i < cluster->freqsKhz.size() && cluster->freqsKhz[i] == khz) {
+            cluster->freqTimeMs[i] = ticks * kMsPerTick;
+        }
+        p = end;
+        while (*p == '\n') {
+            p++;
+        }
+    }
+}
+
+bool CpuStateResidencyDataProvider::getResults(
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (const auto &entity : mEntities) {
+        if (!entity.registered) {
+            continue;
+        }
+        Cluster &cluster = mClusters[entity.cluster];
+        PowerEntityStateResidencyResult result = {.powerEntityId = entity.powerEntityId};
+        uint32_t stateId = 0;
+
+        if (entity.kind == Kind::IDLE) {
+            result.stateResidencyData.resize(cluster.idleStates.size());
+            for (auto &idle : cluster.idleStates) {
+                uint64_t timeUs = 0, usage = 0;
+                for (size_t cpu = 0; cpu < cluster.cpuCount; cpu++) {
+                    timeUs += readCounter(&idle.timeUs[cpu]);
+                    usage += readCounter(&idle.usage[cpu]);
+                }
+                result.stateResidencyData[stateId] = {
+                    .powerEntityStateId = stateId,
+                    .totalTimeInStateMs = timeUs / cluster.cpuCount / 1000,
+                    .totalStateEntryCount = usage};
+                stateId++;
+            }
+        } else {
+            readTimeInState(&cluster);
+            result.stateResidencyData.resize(cluster.freqTimeMs.size());
+            for (uint64_t timeMs : cluster.freqTimeMs) {
+                result.stateResidencyData[stateId] = {.powerEntityStateId = stateId,
+                                                      .totalTimeInStateMs = timeMs};
+                stateId++;
+            }
+        }
+        results.emplace(entity.powerEntityId, result);
+    }
+    return true;
+}
+
+std::vector<PowerEntityStateSpace> CpuStateResidencyDataProvider::getStateSpaces() {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::vector<PowerEntityStateSpace> stateSpaces;
+
+    for (const auto &entity : mEntities) {
+        if (!entity.registered) {
+            continue;
+        }
+        const Cluster &cluster = mClusters[entity.cluster];
+        PowerEntityStateSpace space = {.powerEntityId = entity.powerEntityId};
+        uint32_t stateId = 0;
+        if (entity.kind == Kind::IDLE) {
+            for (const auto &idle : cluster.idleStates) {
+                space.states.push_back({.powerEntityStateId = stateId++,
+                                        .powerEntityStateName = idle.name});
+            }
+        } else {
+            for (uint64_t khz : cluster.freqsKhz) {
+                space.states.push_back({.powerEntityStateId = stateId++,
+                                        .powerEntityStateName = std::to_string(khz) + "KHz"});
+            }
+        }
+        stateSpaces.push_back(space);
+    }
+    return stateSpaces;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
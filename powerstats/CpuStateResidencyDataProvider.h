@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_CPUSTATERESIDENCYDATAPROVIDER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_CPUSTATERESIDENCYDATAPROVIDER_H
+
+#include <android-base/unique_fd.h>
+#include <pixelpowerstats/PowerStats.h>
+
+#include <mutex>
+
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Reports each cpufreq policy (CPU cluster) n as two power entities, so the
+ * states of each stay mutually exclusive:
+ *   CPUCLn_IDLE  the cpuidle states, as residency averaged over the
+ *                cluster's CPUs and entries summed over them
+ *   CPUCLn_FREQ  the policy's frequencies from cpufreq/stats/time_in_state
+ * Time at a frequency includes time spent idle at it.
+ *
+ * Every counter file is opened once and re-read with pread(). A file that
+ * fails, e.g. because its CPU went offline, keeps its last value and is
+ * reopened on the next call.
+ */
+class CpuStateResidencyDataProvider : public IStateResidencyDataProvider {
+  public:
+    // Discovers the clusters under |cpuRoot|, normally /sys/devices/system/cpu.
+    CpuStateResidencyDataProvider(const std::string &cpuRoot);
+    size_t entityCount() const { return mEntities.size(); }
+    const std::string &entityName(size_t entity) const { return mEntities[entity].name; }
+    void setPowerEntityId(size_t entity, uint32_t id);
+
+    bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult>
+            &results) override;
+    std::vector<PowerEntityStateSpace> getStateSpaces() override;
+
+  private:
+    struct CounterFile {
+        std::string path;
+        android::base::unique_fd fd;
+        uint64_t last;
+    };
+    struct IdleState {
+        std::string name;
+        std::vector<CounterFile> timeUs;  // one per CPU
+        std::vector<CounterFile> usage;
+    };
+    struct Cluster {
+        size_t cpuCount;
+        std::vector<IdleState> idleStates;
+        CounterFile timeInState;
+        std::vector<uint64_t> freqsKhz;
+        std::vector<uint64_t> freqTimeMs;  // last read, per frequency
+    };
+
+    enum class Kind { IDLE, FREQ };
+    struct Entity {
+        std::string name;
+        size_t cluster;
+        Kind kind;
+        uint32_t powerEntityId;
+        bool registered;
+    };
+
+    static ssize_t readFile(CounterFile *file, char *buf, size_t size);
+    static uint64_t readCounter(CounterFile *file);
+    static void readTimeInState(Cluster *cluster);
+
+    std::mutex mLock;
+    std::vector<Cluster> mClusters;
+    // Only clusters with cpuidle states or frequencies get the entity.
+    std::vector<Entity> mEntities;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_CPUSTATERESIDENCYDATAPROVIDER_H
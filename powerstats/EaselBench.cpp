@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures EaselStateResidencyDataProvider::getResults() with 1 to 8
+ * threads calling it at once, next to the lock, open and parse per call
+ * that it replaced. Both read a temporary state file. With the watcher
+ * running, getResults() is a Seqlock read, so this is also the reader
+ * contention benchmark for the snapshot.
+ */
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <mutex>
+
+#include "EaselStateResidencyDataProvider.h"
+
+using android::device::google::wahoo::powerstats::EaselStateResidencyDataProvider;
+
+using ResultMap = std::unordered_map<uint32_t, PowerEntityStateResidencyResult>;
+
+// getResults() before the watcher: every caller takes the lock and reads
+// the state node again.
+class LegacyEasel {
+  public:
+    explicit LegacyEasel(const std::string &path) : mPath(path), mOn(0), mNotOn(0) {}
+
+    bool getResults(ResultMap &results) {
+        std::lock_guard<std::mutex> lock(mLock);
+
+        std::ifstream inFile(mPath, std::ifstream::in);
+        unsigned long currentState;
+        if (!inFile.is_open() || !(inFile >> currentState) || currentState >= 3)
+            return false;
+        if (currentState == 1)
+            mOn++;
+        else
+            mNotOn++;
+
+        PowerEntityStateResidencyResult result = {
+            .powerEntityId = 0,
+            .stateResidencyData = {{.powerEntityStateId = 0,
+                                    .totalTimeInStateMs = mNotOn,
+                                    .totalStateEntryCount = mOn,
+                                    .lastEntryTimestampMs = 0}}};
+        results.emplace(std::make_pair(0, result));
+        return true;
+    }
+
+  private:
+    std::mutex mLock;
+    const std::string mPath;
+    uint64_t mOn;
+    uint64_t mNotOn;
+};
+
+static TemporaryFile *gStateFile;
+static EaselStateResidencyDataProvider *gEasel;
+static LegacyEasel *gLegacy;
+
+template <typename Provider>
+static void getResults(benchmark::State &state, Provider *provider) {
+    for (auto _ : state) {
+        ResultMap results;
+        if (!provider->getResults(results)) {
+            state.SkipWithError("getResults failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_Easel(benchmark::State &state) {
+    getResults(state, gEasel);
+}
+BENCHMARK(BM_Easel)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_Legacy(benchmark::State &state) {
+    getResults(state, gLegacy);
+}
+BENCHMARK(BM_Legacy)->ThreadRange(1, 8)->UseRealTime();
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    gStateFile = new TemporaryFile();
+    if (!android::base::WriteStringToFile("1\n", gStateFile->path)) {
+        perror(gStateFile->path);
+        return 1;
+    }
+    gEasel = new EaselStateResidencyDataProvider(0, gStateFile->path);
+    gLegacy = new LegacyEasel(gStateFile->path);
+
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the branch free state parser against a plain digit loop, on the
+ * zero filled buffer readState() gives it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "EaselStateResidencyDataProvider.h"
+
+using android::device::google::wahoo::powerstats::EaselStateResidencyDataProvider;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char buf[EaselStateResidencyDataProvider::kMaxDigits] = {};
+    memcpy(buf, data, std::min(size, sizeof(buf)));
+
+    uint32_t value;
+    bool parsed = EaselStateResidencyDataProvider::parseUint(buf, &value);
+
+    uint32_t expected = 0;
+    size_t digits = 0;
+    for (; digits < sizeof(buf) && buf[digits] >= '0' && buf[digits] <= '9'; digits++)
+        expected = expected * 10 + (buf[digits] - '0');
+
+    if (parsed != (digits > 0) || (parsed && value != expected))
+        abort();
+    return 0;
+}
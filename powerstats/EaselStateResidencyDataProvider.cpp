@@ -17,7 +17,12 @@
 #define LOG_TAG "easelstateresidency"
 
 #include <android-base/logging.h>
-#include <fstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
 #include "EaselStateResidencyDataProvider.h"
 
 namespace android {
@@ -26,72 +31,200 @@ namespace google {
 namespace wahoo {
 namespace powerstats {
 
-const uint32_t EASEL_SYNTHETIC_SLEEP_ID = 0;
+// Backoff for opening a state node that is not there yet.
+static const int kOpenRetryMinMs = 100;
+static const int kOpenRetryMaxMs = 60 * 1000;
 
-EaselStateResidencyDataProvider::EaselStateResidencyDataProvider(uint32_t id) :
-    mPowerEntityId(id), mTotalOnSnapshotCount(0), mTotalNotOnSnapshotCount(0) {}
+static uint64_t bootTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
 
-bool EaselStateResidencyDataProvider::getResults(
-    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
-    const std::string path = "/sys/devices/virtual/misc/mnh_sm/state";
+EaselStateResidencyDataProvider::EaselStateResidencyDataProvider(uint32_t id,
+        const std::string &statePath) :
+    mPowerEntityId(id), mStatePath(statePath), mWatching(false),
+    mResidency{.currentState = NUM_EASEL_STATES},
+    mSnapshot(mResidency) {
+    // Read here rather than by the watcher, so the state is known as soon
+    // as the provider is registered.
+    uint32_t state;
+    if (!openState()) {
+        PLOG(ERROR) << __func__ << ":Failed to open file " << mStatePath << ", will retry";
+    } else if (readState(&state)) {
+        setState(state, bootTimeMs());
+    }
 
-    enum easel_state {
-        EASEL_OFF = 0,
-        EASEL_ON,
-        EASEL_SUSPENDED,
-        NUM_EASEL_STATES
-    };
+    mStopFd.reset(eventfd(0, EFD_CLOEXEC));
+    if (mStopFd < 0) {
+        PLOG(ERROR) << __func__ << ":Failed to create eventfd";
+        return;
+    }
 
-    // Since we are storing stats locally but can have multiple parallel
-    // callers, locking is required to ensure stats are not corrupted.
-    std::lock_guard<std::mutex> lock(mLock);
+    mWatching = true;
+    mWatcher = std::thread(&EaselStateResidencyDataProvider::watcherLoop, this);
+}
+
+EaselStateResidencyDataProvider::~EaselStateResidencyDataProvider() {
+    if (mWatcher.joinable()) {
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(mStopFd, &one, sizeof(one)));
+        mWatcher.join();
+    }
+}
 
-    std::ifstream inFile(path, std::ifstream::in);
-    if (!inFile.is_open()) {
-        PLOG(ERROR) << __func__ << ":Failed to open file " << path;
+/*
+ * Parses the decimal number at the start of |buf| with a fixed trip count
+ * and no data dependent branches: digits are folded in while |valid| stays
+ * set, and it drops at the first byte that is not a digit. |buf| must hold
+ * at least kMaxDigits bytes, zero filled past the data.
+ */
+bool EaselStateResidencyDataProvider::parseUint(const char *buf, uint32_t *value) {
+    uint32_t result = 0;
+    uint32_t valid = 1;
+    uint32_t digits = 0;
+
+    for (int i = 0; i < kMaxDigits; i++) {
+        uint32_t d = static_cast<uint8_t>(buf[i]) - '0';
+        valid &= d < 10;
+        uint32_t mask = -valid;
+        result = ((result * 10 + d) & mask) | (result & ~mask);
+        digits += valid;
+    }
+    *value = result;
+    return digits > 0;
+}
+
+bool EaselStateResidencyDataProvider::openState() {
+    mStateFd.reset(TEMP_FAILURE_RETRY(open(mStatePath.c_str(), O_RDONLY | O_CLOEXEC)));
+    return mStateFd >= 0;
+}
+
+bool EaselStateResidencyDataProvider::readState(uint32_t *state) {
+    char buf[16] = {};
+
+    // sysfs only re-arms the notification after the attribute has been read
+    // again from the start.
+    ssize_t len = TEMP_FAILURE_RETRY(pread(mStateFd, buf, sizeof(buf) - 1, 0));
+    if (len <= 0) {
+        PLOG(ERROR) << __func__ << ":Failed to read " << mStatePath;
         return false;
     }
 
-    unsigned long currentState;
-    if(!(inFile >> currentState) || currentState >= NUM_EASEL_STATES) {
-        PLOG(ERROR) << __func__ << ":Failed to parse " << path;
+    if (!parseUint(buf, state) || *state >= NUM_EASEL_STATES) {
+        LOG(ERROR) << __func__ << ":Failed to parse " << mStatePath;
         return false;
     }
+    return true;
+}
 
-    // Update statistics for synthetic sleep state.  We combine OFF and
-    // SUSPENDED to act as a composite "not on" state so the numbers will behave
-    // like a real sleep state.
-    if ((currentState == EASEL_OFF) || (currentState == EASEL_SUSPENDED)) {
-        mTotalNotOnSnapshotCount++;
-    } else {
-        mTotalOnSnapshotCount++;
+/*
+ * Closes the residency of the current state, opens |state| and publishes
+ * the result, so getResults() never waits for the lock.
+ */
+void EaselStateResidencyDataProvider::setState(uint32_t state, uint64_t nowMs) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    uint32_t current = mResidency.currentState;
+    if (current == state)
+        return;
+
+    if (current < NUM_EASEL_STATES)
+        mResidency.totalTimeMs[current] += nowMs - mResidency.lastEntryMs[current];
+    mResidency.entryCount[state]++;
+    mResidency.lastEntryMs[state] = nowMs;
+    mResidency.currentState = state;
+
+    mSnapshot.write(mResidency);
+}
+
+void EaselStateResidencyDataProvider::watcherLoop() {
+    uint32_t state;
+
+    // The constructor's read armed the notification if the node was there.
+    int delayMs = kOpenRetryMinMs;
+    while (mStateFd < 0) {
+        struct pollfd stop = {.fd = mStopFd, .events = POLLIN};
+        int ret = TEMP_FAILURE_RETRY(poll(&stop, 1, delayMs));
+        if (ret < 0)
+            PLOG(ERROR) << __func__ << ":poll failed, giving up on " << mStatePath;
+        if (ret != 0) {
+            mWatching = false;
+            return;
+        }
+        if (openState()) {
+            LOG(INFO) << __func__ << ":Opened " << mStatePath;
+            if (readState(&state))
+                setState(state, bootTimeMs());
+        }
+        delayMs = std::min(delayMs * 2, kOpenRetryMaxMs);
     }
 
-    // Update statistics for synthetic sleep state, where
-    // totalStateEntryCount = cumulative count of Easel state0 and state2 
-    // (as seen by power.stats HAL)
-    // totalTimeInStateMs = cumulative count of Easel state1 (as seen by
-    //   power.stats HAL)
-    PowerEntityStateResidencyResult result = {
-        .powerEntityId = mPowerEntityId,
-        .stateResidencyData = {{.powerEntityStateId = EASEL_SYNTHETIC_SLEEP_ID,
-                                .totalTimeInStateMs = mTotalNotOnSnapshotCount,
-                                .totalStateEntryCount = mTotalOnSnapshotCount,
-                                .lastEntryTimestampMs = 0}}
+    struct pollfd fds[] = {
+        {.fd = mStateFd, .events = POLLPRI | POLLERR},
+        {.fd = mStopFd, .events = POLLIN},
     };
+    while (true) {
+        if (TEMP_FAILURE_RETRY(poll(fds, 2, -1)) < 0) {
+            PLOG(ERROR) << __func__ << ":poll failed, falling back to sampling";
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if ((fds[0].revents & (POLLPRI | POLLERR)) && readState(&state))
+            setState(state, bootTimeMs());
+    }
+    mWatching = false;
+}
+
+bool EaselStateResidencyDataProvider::getResults(
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
+    // Without the watcher, sample the state through the descriptor it left
+    // open, if any; only the counter update takes the lock.
+    if (!mWatching) {
+        uint32_t currentState;
+        if (mStateFd < 0 || !readState(&currentState))
+            return false;
+        setState(currentState, bootTimeMs());
+    }
+
+    Residency residency = mSnapshot.read();
+    uint32_t current = residency.currentState;
+    if (current >= NUM_EASEL_STATES) {
+        LOG(ERROR) << __func__ << ":Easel state not known yet";
+        return false;
+    }
+    // Count the time spent so far in the current state.
+    residency.totalTimeMs[current] += bootTimeMs() - residency.lastEntryMs[current];
+
+    PowerEntityStateResidencyResult result = {.powerEntityId = mPowerEntityId};
+    result.stateResidencyData.resize(NUM_EASEL_STATES);
+    for (uint32_t i = 0; i < NUM_EASEL_STATES; i++) {
+        result.stateResidencyData[i] = {.powerEntityStateId = i,
+                                        .totalTimeInStateMs = residency.totalTimeMs[i],
+                                        .totalStateEntryCount = residency.entryCount[i],
+                                        .lastEntryTimestampMs = residency.lastEntryMs[i]};
+    }
 
     results.emplace(std::make_pair(mPowerEntityId, result));
     return true;
 }
 
-
 std::vector<PowerEntityStateSpace> EaselStateResidencyDataProvider::getStateSpaces() {
     return {
         {.powerEntityId = mPowerEntityId,
             .states = {
                 {
-                 .powerEntityStateId = EASEL_SYNTHETIC_SLEEP_ID,
-                 .powerEntityStateName = "SyntheticSleep"
+                 .powerEntityStateId = EASEL_OFF,
+                 .powerEntityStateName = "Off"
+                },
+                {
+                 .powerEntityStateId = EASEL_ON,
+                 .powerEntityStateName = "On"
+                },
+                {
+                 .powerEntityStateId = EASEL_SUSPENDED,
+                 .powerEntityStateName = "Suspended"
                 }
             }
         }
@@ -102,4 +235,4 @@ std::vector<PowerEntityStateSpace> EaselStateResidencyDataProvider::getStateSpac
 }  // namespace wahoo
 }  // namespace google
 }  // namespace device
-}  // namespace android
\ No newline at end of file
+}  // namespace android
@@ -16,8 +16,14 @@
 #ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_EASELSTATERESIDENCYDATAPROVIDER_H
 #define DEVICE_GOOGLE_WAHOO_POWERSTATS_EASELSTATERESIDENCYDATAPROVIDER_H
 
+#include <android-base/unique_fd.h>
 #include <pixelpowerstats/PowerStats.h>
 
+#include <atomic>
+#include <thread>
+
+#include "Seqlock.h"
+
 using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
 using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
 using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
@@ -28,19 +34,65 @@ namespace google {
 namespace wahoo {
 namespace powerstats {
 
+/*
+ * Tracks how long Easel spends in each mnh_sm state. The constructor
+ * publishes the state it finds, then a watcher thread waits for
+ * sysfs_notify() on the state node and timestamps every transition with
+ * CLOCK_BOOTTIME; getResults() only copies the accumulated counters, adding
+ * the time spent so far in the current state.
+ *
+ * The node only exists once the mnh_sm driver has probed, so if it cannot
+ * be opened yet the watcher retries with backoff; until then getResults()
+ * fails. If the watcher cannot run at all, getResults() samples the state
+ * itself, and residency is only as accurate as the callers are frequent.
+ */
 class EaselStateResidencyDataProvider : public IStateResidencyDataProvider {
   public:
-    EaselStateResidencyDataProvider(uint32_t id);
-    ~EaselStateResidencyDataProvider() = default;
+    // |statePath| is the mnh_sm state node, overridable for testing with
+    // captured or synthetic state files.
+    EaselStateResidencyDataProvider(uint32_t id, const std::string &statePath = kDefaultStatePath);
+    ~EaselStateResidencyDataProvider();
     bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult>
             &results) override;
     std::vector<PowerEntityStateSpace> getStateSpaces() override;
 
+    static constexpr const char *kDefaultStatePath = "/sys/devices/virtual/misc/mnh_sm/state";
+
+    // Parses the state number at the start of |buf|; public for the fuzzer.
+    static bool parseUint(const char *buf, uint32_t *value);
+    static constexpr int kMaxDigits = 4;
+
   private:
+    enum EaselState : uint32_t {
+        EASEL_OFF = 0,
+        EASEL_ON,
+        EASEL_SUSPENDED,
+        NUM_EASEL_STATES
+    };
+
+    // Published as a whole on every transition.
+    struct Residency {
+        uint32_t currentState;
+        uint64_t totalTimeMs[NUM_EASEL_STATES];
+        uint64_t entryCount[NUM_EASEL_STATES];
+        uint64_t lastEntryMs[NUM_EASEL_STATES];
+    };
+
+    bool openState();
+    bool readState(uint32_t *state);
+    void setState(uint32_t state, uint64_t nowMs);
+    void watcherLoop();
+
+    // Serializes writers; readers go through mSnapshot instead.
     std::mutex mLock;
     const uint32_t mPowerEntityId;
-    uint64_t mTotalOnSnapshotCount;
-    uint64_t mTotalNotOnSnapshotCount;
+    const std::string mStatePath;
+    android::base::unique_fd mStateFd;  // reopened only by the watcher while mWatching
+    android::base::unique_fd mStopFd;
+    std::thread mWatcher;
+    std::atomic<bool> mWatching;
+    Residency mResidency;  // writer's copy, guarded by mLock
+    Seqlock<Residency> mSnapshot;
 };
 
 }  // namespace powerstats
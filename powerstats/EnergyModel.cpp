@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerstatsenergymodel"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <json/json.h>
+#include <algorithm>
+#include <cmath>
+#include "EnergyModel.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static bool parseCoefficient(const Json::Value &value, const std::string &what, double *mw) {
+    if (!value.isNumeric() || !std::isfinite(value.asDouble()) || value.asDouble() < 0) {
+        LOG(ERROR) << __func__ << ":Invalid coefficient for " << what;
+        return false;
+    }
+    *mw = value.asDouble();
+    return true;
+}
+
+std::unique_ptr<EnergyModel> EnergyModel::load(const std::string &path,
+        const std::unordered_map<uint32_t, std::string> &entityNames,
+        const std::vector<PowerEntityStateSpace> &stateSpaces) {
+    std::string content;
+    if (!android::base::ReadFileToString(path, &content)) {
+        PLOG(ERROR) << __func__ << ":Failed to read " << path;
+        return nullptr;
+    }
+
+    Json::Value root;
+    std::string errors;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(content.data(), content.data() + content.size(), &root, &errors)) {
+        LOG(ERROR) << __func__ << ":Failed to parse " << path << ": " << errors;
+        return nullptr;
+    }
+    const Json::Value &entities = root["entities"];
+    if (!entities.isObject()) {
+        LOG(ERROR) << __func__ << ":" << path << " has no entities object";
+        return nullptr;
+    }
+
+    std::unique_ptr<EnergyModel> model(new EnergyModel());
+    for (const auto &name : entities.getMemberNames()) {
+        const Json::Value &config = entities[name];
+        auto id = std::find_if(entityNames.begin(), entityNames.end(),
+                               [&name](const auto &e) { return e.second == name; });
+        if (id == entityNames.end()) {
+            LOG(INFO) << __func__ << ":" << name << " is not registered, skipping";
+            continue;
+        }
+        auto space = std::find_if(stateSpaces.begin(), stateSpaces.end(),
+                [&id](const auto &s) { return s.powerEntityId == id->first; });
+        if (space == stateSpaces.end()) {
+            LOG(ERROR) << __func__ << ":" << name << " has no state residency provider";
+            return nullptr;
+        }
+
+        Entity entity = {.activeMw = 0};
+        if (config.isMember("active_mw") &&
+                !parseCoefficient(config["active_mw"], name + " active", &entity.activeMw)) {
+            return nullptr;
+        }
+        const Json::Value &states = config["states"];
+        if (!states.isObject()) {
+            LOG(ERROR) << __func__ << ":" << name << " has no states object";
+            return nullptr;
+        }
+        for (const auto &stateName : states.getMemberNames()) {
+            auto state = std::find_if(space->states.begin(), space->states.end(),
+                    [&stateName](const auto &s) { return s.powerEntityStateName == stateName; });
+            if (state == space->states.end()) {
+                LOG(ERROR) << __func__ << ":" << name << " has no state " << stateName;
+                return nullptr;
+            }
+            double mw;
+            if (!parseCoefficient(states[stateName], name + " " + stateName, &mw)) {
+                return nullptr;
+            }
+            entity.stateMw[state->powerEntityStateId] = mw;
+        }
+        model->mEntities[id->first] = std::move(entity);
+    }
+    return model;
+}
+
+bool EnergyModel::hasEntity(uint32_t powerEntityId) const {
+    return mEntities.count(powerEntityId) != 0;
+}
+
+uint64_t EnergyModel::stateEnergyUj(uint32_t powerEntityId, uint32_t powerEntityStateId,
+                                    uint64_t timeMs) const {
+    auto entity = mEntities.find(powerEntityId);
+    if (entity == mEntities.end()) {
+        return 0;
+    }
+    auto state = entity->second.stateMw.find(powerEntityStateId);
+    if (state == entity->second.stateMw.end()) {
+        return 0;
+    }
+    return std::llround(state->second * timeMs);
+}
+
+uint64_t EnergyModel::activeEnergyUj(uint32_t powerEntityId, uint64_t timeMs) const {
+    auto entity = mEntities.find(powerEntityId);
+    if (entity == mEntities.end()) {
+        return 0;
+    }
+    return std::llround(entity->second.activeMw * timeMs);
+}
+
+EntityEnergy EnergyModel::estimate(uint32_t powerEntityId,
+                                   const hidl_vec<PowerEntityStateResidencyData> &data,
+                                   uint64_t intervalMs) const {
+    uint64_t stateMs = 0;
+    uint64_t energyUj = 0;
+    for (const auto &state : data) {
+        stateMs += state.totalTimeInStateMs;
+        energyUj += stateEnergyUj(powerEntityId, state.powerEntityStateId,
+                                  state.totalTimeInStateMs);
+    }
+    // Counters are sampled slightly apart from the clock, so clamp.
+    uint64_t activeMs = intervalMs > stateMs ? intervalMs - stateMs : 0;
+    energyUj += activeEnergyUj(powerEntityId, activeMs);
+    return {.intervalMs = intervalMs, .activeMs = activeMs, .energyUj = energyUj};
+}
+
+std::vector<uint32_t> EnergyModel::entityIds() const {
+    std::vector<uint32_t> ids;
+    for (const auto &entity : mEntities) {
+        ids.push_back(entity.first);
+    }
+    return ids;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_ENERGYMODEL_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_ENERGYMODEL_H
+
+#include <android/hardware/power/stats/1.0/types.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using android::hardware::hidl_vec;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyData;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+// Estimated energy of one power entity over one interval.
+struct EntityEnergy {
+    uint64_t intervalMs;
+    uint64_t activeMs;  // part of the interval not covered by any reported state
+    uint64_t energyUj;
+};
+
+/*
+ * Per-state power coefficients for the registered power entities, loaded
+ * from a JSON table of the form
+ *
+ *   { "entities": { "<entity>": { "active_mw": <mW>,
+ *                                 "states": { "<state>": <mW>, ... } } } }
+ *
+ * Time spent in a state is charged at that state's coefficient and the rest
+ * of the interval at active_mw. Power in mW times time in ms gives uJ.
+ * Entities in the table that were not registered (e.g. the debugfs ones on
+ * user builds) are skipped.
+ */
+class EnergyModel {
+  public:
+    static std::unique_ptr<EnergyModel> load(const std::string &path,
+            const std::unordered_map<uint32_t, std::string> &entityNames,
+            const std::vector<PowerEntityStateSpace> &stateSpaces);
+
+    bool hasEntity(uint32_t powerEntityId) const;
+    // Energy of |timeMs| spent in a state, 0 if the state is not modeled.
+    uint64_t stateEnergyUj(uint32_t powerEntityId, uint32_t powerEntityStateId,
+                           uint64_t timeMs) const;
+    // Energy of |timeMs| spent outside every reported state.
+    uint64_t activeEnergyUj(uint32_t powerEntityId, uint64_t timeMs) const;
+    // |data| holds the time spent in each state during |intervalMs|.
+    EntityEnergy estimate(uint32_t powerEntityId,
+                          const hidl_vec<PowerEntityStateResidencyData> &data,
+                          uint64_t intervalMs) const;
+    std::vector<uint32_t> entityIds() const;
+
+  private:
+    struct Entity {
+        double activeMw;
+        std::unordered_map<uint32_t, double> stateMw;
+    };
+    std::map<uint32_t, Entity> mEntities;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_ENERGYMODEL_H
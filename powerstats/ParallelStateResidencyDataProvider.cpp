@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "parallelstateresidency"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include "ParallelStateResidencyDataProvider.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+ParallelStateResidencyDataProvider::ParallelStateResidencyDataProvider(
+        size_t workers, std::chrono::milliseconds deadline)
+    : mDeadline(deadline), mStopping(false) {
+    for (size_t i = 0; i < workers; i++) {
+        mWorkers.emplace_back(&ParallelStateResidencyDataProvider::workerLoop, this);
+    }
+}
+
+ParallelStateResidencyDataProvider::~ParallelStateResidencyDataProvider() {
+    {
+        std::lock_guard<std::mutex> lock(mTaskLock);
+        mStopping = true;
+    }
+    mTaskCv.notify_all();
+    for (auto &worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void ParallelStateResidencyDataProvider::addProvider(const std::string &name,
+                                                     sp<IStateResidencyDataProvider> p) {
+    std::vector<PowerEntityStateSpace> spaces = p->getStateSpaces();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    for (const auto &space : spaces) {
+        mOwners[space.powerEntityId] = mChildren.size();
+    }
+    mChildren.push_back({.name = name, .provider = p, .inFlight = false, .completed = 0,
+                         .ok = false, .stale = 0});
+}
+
+void ParallelStateResidencyDataProvider::workerLoop() {
+    std::unique_lock<std::mutex> lock(mTaskLock);
+    while (true) {
+        mTaskCv.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+        if (mStopping) {
+            return;
+        }
+        size_t index = mTasks.front();
+        mTasks.pop_front();
+        lock.unlock();
+        runChild(index);
+        lock.lock();
+    }
+}
+
+void ParallelStateResidencyDataProvider::runChild(size_t index) {
+    sp<IStateResidencyDataProvider> provider;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        provider = mChildren[index].provider;
+    }
+
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+    bool ok = provider->getResults(results);
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        Child &child = mChildren[index];
+        // Keep the last good results for later stale answers.
+        if (ok || child.completed == 0) {
+            child.results = std::move(results);
+        }
+        child.ok = ok;
+        child.completed++;
+        child.inFlight = false;
+        child.updated = std::chrono::steady_clock::now();
+    }
+    mDoneCv.notify_all();
+}
+
+bool ParallelStateResidencyDataProvider::getResults(
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
+    std::vector<size_t> children;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (size_t i = 0; i < mChildren.size(); i++) {
+            children.push_back(i);
+        }
+    }
+    return collect(results, children);
+}
+
+bool ParallelStateResidencyDataProvider::getResults(
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results,
+        const std::vector<uint32_t> &entityIds) {
+    std::vector<size_t> children;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        std::vector<bool> wanted(mChildren.size());
+        for (uint32_t id : entityIds) {
+            auto owner = mOwners.find(id);
+            if (owner == mOwners.end()) {
+                wanted.assign(mChildren.size(), true);
+                break;
+            }
+            wanted[owner->second] = true;
+        }
+        for (size_t i = 0; i < mChildren.size(); i++) {
+            if (wanted[i]) {
+                children.push_back(i);
+            }
+        }
+    }
+    return collect(results, children);
+}
+
+bool ParallelStateResidencyDataProvider::collect(
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results,
+        const std::vector<size_t> &children) {
+    auto deadline = std::chrono::steady_clock::now() + mDeadline;
+    std::unique_lock<std::mutex> lock(mLock);
+
+    // Start every child that isn't still busy with an earlier call.
+    std::vector<uint64_t> started(mChildren.size());
+    std::vector<size_t> queued;
+    for (size_t i : children) {
+        started[i] = mChildren[i].completed;
+        if (!mChildren[i].inFlight) {
+            mChildren[i].inFlight = true;
+            queued.push_back(i);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> taskLock(mTaskLock);
+        mTasks.insert(mTasks.end(), queued.begin(), queued.end());
+    }
+    mTaskCv.notify_all();
+
+    mDoneCv.wait_until(lock, deadline, [this, &children, &started] {
+        for (size_t i : children) {
+            if (mChildren[i].completed == started[i]) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    bool ok = true;
+    for (size_t i : children) {
+        Child &child = mChildren[i];
+        if (child.completed == started[i]) {
+            uint64_t stale = ++child.stale;
+            if ((stale & (stale - 1)) == 0) {
+                LOG(WARNING) << __func__ << ":" << child.name << " missed the "
+                             << mDeadline.count() << "ms deadline (" << stale << " times)";
+            }
+            // Nothing to fall back on yet.
+            if (child.completed == 0) {
+                ok = false;
+                continue;
+            }
+        } else if (!child.ok) {
+            ok = false;
+        }
+        results.insert(child.results.begin(), child.results.end());
+    }
+    return ok;
+}
+
+std::vector<PowerEntityStateSpace> ParallelStateResidencyDataProvider::getStateSpaces() {
+    std::vector<sp<IStateResidencyDataProvider>> providers;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (const auto &child : mChildren) {
+            providers.push_back(child.provider);
+        }
+    }
+
+    std::vector<PowerEntityStateSpace> stateSpaces;
+    for (const auto &provider : providers) {
+        std::vector<PowerEntityStateSpace> spaces = provider->getStateSpaces();
+        stateSpaces.insert(stateSpaces.end(), spaces.begin(), spaces.end());
+    }
+    return stateSpaces;
+}
+
+void ParallelStateResidencyDataProvider::dump(int fd) {
+    auto now = std::chrono::steady_clock::now();
+    std::string out = android::base::StringPrintf("%-8s %8s %8s %10s %s\n", "Provider", "Calls",
+                                                  "Stale", "Age(ms)", "State");
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (const auto &child : mChildren) {
+            int64_t ageMs = child.completed
+                    ? std::chrono::duration_cast<std::chrono::milliseconds>(now - child.updated)
+                              .count()
+                    : -1;
+            android::base::StringAppendF(&out, "%-8s %8" PRIu64 " %8" PRIu64 " %10" PRId64
+                                         " %s\n", child.name.c_str(), child.completed,
+                                         child.stale, ageMs,
+                                         child.inFlight ? "running" :
+                                                 child.ok ? "ok" : "failed");
+        }
+    }
+    android::base::StringAppendF(&out, "%zu workers, deadline %" PRId64 " ms\n", mWorkers.size(),
+                                 static_cast<int64_t>(mDeadline.count()));
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
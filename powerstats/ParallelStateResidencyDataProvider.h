@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_PARALLELSTATERESIDENCYDATAPROVIDER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_PARALLELSTATERESIDENCYDATAPROVIDER_H
+
+#include <pixelpowerstats/PowerStats.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Queries its child providers concurrently on a small worker pool, so a call
+ * takes as long as the slowest child rather than the sum of all of them.
+ *
+ * A child that misses the deadline keeps running in the background and its
+ * previous results are returned instead. Such stale results are counted per
+ * child and shown by dump(). A child is never queued twice, so a stuck node
+ * ties up at most one worker.
+ */
+class ParallelStateResidencyDataProvider : public IStateResidencyDataProvider {
+  public:
+    ParallelStateResidencyDataProvider(size_t workers, std::chrono::milliseconds deadline);
+    ~ParallelStateResidencyDataProvider();
+    void addProvider(const std::string &name, sp<IStateResidencyDataProvider> p);
+
+    bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results)
+            override;
+    // Only queries the children that report |entityIds|; all of them if an id
+    // belongs to no child.
+    bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results,
+                    const std::vector<uint32_t> &entityIds);
+    std::vector<PowerEntityStateSpace> getStateSpaces() override;
+
+    void dump(int fd);
+
+  private:
+    struct Child {
+        std::string name;
+        sp<IStateResidencyDataProvider> provider;
+        bool inFlight;
+        uint64_t completed;  // number of finished calls
+        bool ok;
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+        std::chrono::steady_clock::time_point updated;
+        uint64_t stale;
+    };
+
+    void workerLoop();
+    void runChild(size_t index);
+    bool collect(std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results,
+                 const std::vector<size_t> &children);
+
+    const std::chrono::milliseconds mDeadline;
+
+    // Guards the children and signals completed calls.
+    std::mutex mLock;
+    std::condition_variable mDoneCv;
+    std::vector<Child> mChildren;
+    // Child reporting each entity, from the state spaces at addProvider().
+    std::unordered_map<uint32_t, size_t> mOwners;
+
+    std::mutex mTaskLock;
+    std::condition_variable mTaskCv;
+    std::deque<size_t> mTasks;
+    bool mStopping;
+    std::vector<std::thread> mWorkers;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_PARALLELSTATERESIDENCYDATAPROVIDER_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmarks config loading and residency queries on the device. The
+ * service parses a snapshot of the live nodes rather than the nodes
+ * themselves, so every iteration sees the same content: /d/system_stats,
+ * /d/wlan0/power_stats and the Easel state are copied into a scratch
+ * directory with testdata/powerstats_config.json, which names them by
+ * relative path. Reading debugfs needs root.
+ */
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <map>
+
+#include "EaselStateResidencyDataProvider.h"
+#include "PowerStatsConfig.h"
+#include "WahooPowerStats.h"
+
+using android::sp;
+using android::device::google::wahoo::powerstats::EaselStateResidencyDataProvider;
+using android::device::google::wahoo::powerstats::PowerStatsConfig;
+using android::device::google::wahoo::powerstats::WahooPowerStats;
+using android::hardware::power::stats::V1_0::PowerEntityInfo;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+static const char kConfig[] = "powerstats_config.json";
+
+// Live node, and the name testdata/powerstats_config.json gives its copy.
+static const std::pair<const char *, const char *> kNodes[] = {
+    {"/d/system_stats", "system_stats"},
+    {"/d/wlan0/power_stats", "wlan_power_stats"},
+    {EaselStateResidencyDataProvider::kDefaultStatePath, "easel_state"},
+};
+
+static sp<WahooPowerStats> gService;
+
+static bool copyFile(const std::string &from, const std::string &to) {
+    std::string data;
+    if (!android::base::ReadFileToString(from, &data) ||
+            !android::base::WriteStringToFile(data, to)) {
+        fprintf(stderr, "cannot copy %s: %s\n", from.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Prints every state's residency once so the parse can be checked by eye.
+static bool printResidency(WahooPowerStats *service) {
+    std::map<uint32_t, std::string> entities;
+    std::map<std::pair<uint32_t, uint32_t>, std::string> states;
+    bool ok = true;
+
+    service->getPowerEntityInfo([&](const auto &infos, Status status) {
+        ok &= status == Status::SUCCESS;
+        for (const PowerEntityInfo &info : infos)
+            entities[info.powerEntityId] = info.powerEntityName;
+    });
+    service->getPowerEntityStateInfo({}, [&](const auto &spaces, Status status) {
+        ok &= status == Status::SUCCESS;
+        for (const PowerEntityStateSpace &space : spaces) {
+            for (const auto &state : space.states)
+                states[{space.powerEntityId, state.powerEntityStateId}] =
+                        state.powerEntityStateName;
+        }
+    });
+    service->getPowerEntityStateResidencyData({}, [&](const auto &results, Status status) {
+        ok &= status == Status::SUCCESS;
+        for (const PowerEntityStateResidencyResult &result : results) {
+            for (const auto &data : result.stateResidencyData) {
+                printf("%s.%s: %" PRIu64 " entries, %" PRIu64 " ms, last %" PRIu64 " ms\n",
+                       entities[result.powerEntityId].c_str(),
+                       states[{result.powerEntityId, data.powerEntityStateId}].c_str(),
+                       data.totalStateEntryCount, data.totalTimeInStateMs,
+                       data.lastEntryTimestampMs);
+            }
+        }
+    });
+    if (!ok)
+        fprintf(stderr, "a power.stats query failed\n");
+    return ok;
+}
+
+static void BM_ConfigLoad(benchmark::State &state) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(PowerStatsConfig::load(kConfig));
+}
+BENCHMARK(BM_ConfigLoad);
+
+static void BM_ResidencyQuery(benchmark::State &state) {
+    for (auto _ : state)
+        gService->getPowerEntityStateResidencyData({}, [](const auto &, Status) {});
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ResidencyQuery);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    TemporaryDir scratch;
+    std::string testdata = android::base::GetExecutableDirectory() + "/testdata/";
+    if (!copyFile(testdata + kConfig, std::string(scratch.path) + "/" + kConfig))
+        return 1;
+    for (const auto &node : kNodes) {
+        if (!copyFile(node.first, std::string(scratch.path) + "/" + node.second))
+            return 1;
+    }
+    if (chdir(scratch.path) != 0) {
+        perror(scratch.path);
+        return 1;
+    }
+
+    std::unique_ptr<PowerStatsConfig> config = PowerStatsConfig::load(kConfig);
+    if (!config) {
+        fprintf(stderr, "cannot load %s\n", kConfig);
+        return 1;
+    }
+    gService = new WahooPowerStats();
+    config->apply(gService.get(), true);
+    if (!printResidency(gService.get()))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerstatsconfig"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <json/json.h>
+#include <pixelpowerstats/WlanStateResidencyDataProvider.h>
+#include <algorithm>
+#include <set>
+#include "CoolingDeviceStateResidencyDataProvider.h"
+#include "CpuStateResidencyDataProvider.h"
+#include "EaselStateResidencyDataProvider.h"
+#include "PowerStatsConfig.h"
+#include "SharedFileSource.h"
+#include "SharedFileStateResidencyDataProvider.h"
+
+using android::hardware::google::pixel::powerstats::WlanStateResidencyDataProvider;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static const uint32_t kDefaultCoolingPollMs = 1000;
+
+static bool parseString(const Json::Value &value, const std::string &what, std::string *out) {
+    if (!value.isString() || value.asString().empty()) {
+        LOG(ERROR) << __func__ << ":" << what << " must be a non-empty string";
+        return false;
+    }
+    *out = value.asString();
+    return true;
+}
+
+static bool parseEntityType(const Json::Value &value, const std::string &what,
+                            PowerEntityType *type) {
+    static const std::pair<const char *, PowerEntityType> kTypes[] = {
+        {"SUBSYSTEM", PowerEntityType::SUBSYSTEM},
+        {"PERIPHERAL", PowerEntityType::PERIPHERAL},
+        {"POWER_DOMAIN", PowerEntityType::POWER_DOMAIN},
+    };
+    for (const auto &t : kTypes) {
+        if (value.isString() && value.asString() == t.first) {
+            *type = t.second;
+            return true;
+        }
+    }
+    LOG(ERROR) << __func__ << ":" << what << " has an unknown entity type";
+    return false;
+}
+
+// Parses one of a state's counters. Returns true with |*supported| false if
+// the counter is absent.
+static bool parseField(const Json::Value &state, const char *key, const std::string &what,
+                       bool *supported, std::string *prefix,
+                       std::function<uint64_t(uint64_t)> *transform) {
+    *supported = false;
+    if (!state.isMember(key)) {
+        return true;
+    }
+    const Json::Value &field = state[key];
+    std::string fieldWhat = what + "." + key;
+    if (!field.isObject() || !parseString(field["prefix"], fieldWhat + ".prefix", prefix)) {
+        return false;
+    }
+    if (field.isMember("divisor")) {
+        const Json::Value &divisor = field["divisor"];
+        if (!divisor.isUInt() || divisor.asUInt() == 0) {
+            LOG(ERROR) << __func__ << ":" << fieldWhat << ".divisor must be a positive integer";
+            return false;
+        }
+        uint64_t d = divisor.asUInt();
+        *transform = [d](uint64_t a) { return a / d; };
+    }
+    *supported = true;
+    return true;
+}
+
+static bool parseStates(const Json::Value &states, const std::string &what,
+                        std::vector<StateResidencyConfig> *configs) {
+    if (!states.isArray() || states.size() == 0) {
+        LOG(ERROR) << __func__ << ":" << what << " must be a non-empty array";
+        return false;
+    }
+    std::set<std::string> names;
+    for (Json::ArrayIndex i = 0; i < states.size(); i++) {
+        const Json::Value &state = states[i];
+        std::string stateWhat = what + "[" + std::to_string(i) + "]";
+        StateResidencyConfig config;
+        if (!state.isObject() || !parseString(state["name"], stateWhat + ".name", &config.name)) {
+            return false;
+        }
+        if (!names.insert(config.name).second) {
+            LOG(ERROR) << __func__ << ":" << stateWhat << " duplicates state " << config.name;
+            return false;
+        }
+        if (state.isMember("header") &&
+                !parseString(state["header"], stateWhat + ".header", &config.header)) {
+            return false;
+        }
+        if (!parseField(state, "entry_count", stateWhat, &config.entryCountSupported,
+                        &config.entryCountPrefix, &config.entryCountTransform) ||
+                !parseField(state, "total_time", stateWhat, &config.totalTimeSupported,
+                            &config.totalTimePrefix, &config.totalTimeTransform) ||
+                !parseField(state, "last_entry", stateWhat, &config.lastEntrySupported,
+                            &config.lastEntryPrefix, &config.lastEntryTransform)) {
+            return false;
+        }
+        if (!config.entryCountSupported && !config.totalTimeSupported &&
+                !config.lastEntrySupported) {
+            LOG(ERROR) << __func__ << ":" << stateWhat << " reports no counters";
+            return false;
+        }
+        configs->push_back(config);
+    }
+    return true;
+}
+
+std::unique_ptr<PowerStatsConfig> PowerStatsConfig::load(const std::string &path) {
+    std::string content;
+    if (!android::base::ReadFileToString(path, &content)) {
+        PLOG(ERROR) << __func__ << ":Failed to read " << path;
+        return nullptr;
+    }
+
+    Json::Value root;
+    std::string errors;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(content.data(), content.data() + content.size(), &root, &errors)) {
+        LOG(ERROR) << __func__ << ":Failed to parse " << path << ": " << errors;
+        return nullptr;
+    }
+    if (!root.isObject()) {
+        LOG(ERROR) << __func__ << ":" << path << " must hold a JSON object";
+        return nullptr;
+    }
+
+    std::unique_ptr<PowerStatsConfig> config(new PowerStatsConfig());
+
+    const Json::Value &sources = root["sources"];
+    if (root.isMember("sources") && !sources.isArray()) {
+        LOG(ERROR) << __func__ << ":sources must be an array";
+        return nullptr;
+    }
+    for (Json::ArrayIndex i = 0; root.isMember("sources") && i < sources.size(); i++) {
+        const Json::Value &source = sources[i];
+        std::string what = "sources[" + std::to_string(i) + "]";
+        Source s = {.ttl = std::chrono::milliseconds(0)};
+        if (!source.isObject() || !parseString(source["name"], what + ".name", &s.name) ||
+                !parseString(source["path"], what + ".path", &s.path)) {
+            return nullptr;
+        }
+        if (source.isMember("ttl_ms")) {
+            if (!source["ttl_ms"].isUInt()) {
+                LOG(ERROR) << __func__ << ":" << what << ".ttl_ms must be an integer";
+                return nullptr;
+            }
+            s.ttl = std::chrono::milliseconds(source["ttl_ms"].asUInt());
+        }
+        config->mSources.push_back(s);
+    }
+
+    const Json::Value &stateSets = root["state_sets"];
+    if (root.isMember("state_sets") && !stateSets.isObject()) {
+        LOG(ERROR) << __func__ << ":state_sets must be an object";
+        return nullptr;
+    }
+
+    const Json::Value &providers = root["providers"];
+    if (!providers.isArray() || providers.size() == 0) {
+        LOG(ERROR) << __func__ << ":providers must be a non-empty array";
+        return nullptr;
+    }
+    std::set<std::string> providerNames, entityNames;
+    for (Json::ArrayIndex i = 0; i < providers.size(); i++) {
+        const Json::Value &provider = providers[i];
+        std::string what = "providers[" + std::to_string(i) + "]";
+        Provider p = {.source = 0, .pollInterval = std::chrono::milliseconds(0),
+                      .debuggableOnly = false, .history = true};
+        std::string type;
+        if (!provider.isObject() || !parseString(provider["name"], what + ".name", &p.name) ||
+                !parseString(provider["type"], what + ".type", &type)) {
+            return nullptr;
+        }
+        if (!providerNames.insert(p.name).second) {
+            LOG(ERROR) << __func__ << ":" << what << " duplicates provider " << p.name;
+            return nullptr;
+        }
+        if (provider.isMember("debuggable_only")) {
+            if (!provider["debuggable_only"].isBool()) {
+                LOG(ERROR) << __func__ << ":" << what << ".debuggable_only must be a boolean";
+                return nullptr;
+            }
+            p.debuggableOnly = provider["debuggable_only"].asBool();
+        }
+        // Reading the WLAN node makes the driver query the firmware, which is
+        // too costly to do every history interval unless asked for.
+        p.history = type != "wlan";
+        if (provider.isMember("history")) {
+            if (!provider["history"].isBool()) {
+                LOG(ERROR) << __func__ << ":" << what << ".history must be a boolean";
+                return nullptr;
+            }
+            p.history = provider["history"].asBool();
+        }
+
+        if (type == "shared_file") {
+            p.type = ProviderType::SHARED_FILE;
+            std::string source;
+            if (!parseString(provider["source"], what + ".source", &source)) {
+                return nullptr;
+            }
+            auto s = std::find_if(config->mSources.begin(), config->mSources.end(),
+                                  [&source](const Source &s) { return s.name == source; });
+            if (s == config->mSources.end()) {
+                LOG(ERROR) << __func__ << ":" << what << " uses unknown source " << source;
+                return nullptr;
+            }
+            p.source = s - config->mSources.begin();
+        } else if (type == "wlan") {
+            p.type = ProviderType::WLAN;
+            if (!parseString(provider["path"], what + ".path", &p.path)) {
+                return nullptr;
+            }
+        } else if (type == "easel") {
+            p.type = ProviderType::EASEL;
+            p.path = EaselStateResidencyDataProvider::kDefaultStatePath;
+            if (provider.isMember("path") &&
+                    !parseString(provider["path"], what + ".path", &p.path)) {
+                return nullptr;
+            }
+        } else if (type == "cpu" || type == "cooling") {
+            p.type = type == "cpu" ? ProviderType::CPU : ProviderType::COOLING;
+            if (!parseString(provider["path"], what + ".path", &p.path)) {
+                return nullptr;
+            }
+            if (p.type == ProviderType::COOLING) {
+                p.pollInterval = std::chrono::milliseconds(kDefaultCoolingPollMs);
+                if (provider.isMember("poll_ms")) {
+                    if (!provider["poll_ms"].isUInt() || provider["poll_ms"].asUInt() == 0) {
+                        LOG(ERROR) << __func__ << ":" << what
+                                   << ".poll_ms must be a positive integer";
+                        return nullptr;
+                    }
+                    p.pollInterval = std::chrono::milliseconds(provider["poll_ms"].asUInt());
+                }
+            }
+            if (provider.isMember("entities")) {
+                LOG(ERROR) << __func__ << ":" << what << " discovers its entities";
+                return nullptr;
+            }
+            config->mProviders.push_back(p);
+            continue;
+        } else {
+            LOG(ERROR) << __func__ << ":" << what << " has unknown type " << type;
+            return nullptr;
+        }
+
+        const Json::Value &entities = provider["entities"];
+        if (!entities.isArray() || entities.size() == 0) {
+            LOG(ERROR) << __func__ << ":" << what << ".entities must be a non-empty array";
+            return nullptr;
+        }
+        // The WLAN and Easel providers report one entity with built-in states.
+        if (p.type != ProviderType::SHARED_FILE && entities.size() != 1) {
+            LOG(ERROR) << __func__ << ":" << what << " must have exactly one entity";
+            return nullptr;
+        }
+        for (Json::ArrayIndex j = 0; j < entities.size(); j++) {
+            const Json::Value &entity = entities[j];
+            std::string entityWhat = what + ".entities[" + std::to_string(j) + "]";
+            Entity e;
+            if (!entity.isObject() ||
+                    !parseString(entity["name"], entityWhat + ".name", &e.name) ||
+                    !parseEntityType(entity["type"], entityWhat + ".type", &e.type)) {
+                return nullptr;
+            }
+            if (!entityNames.insert(e.name).second) {
+                LOG(ERROR) << __func__ << ":" << entityWhat << " duplicates entity " << e.name;
+                return nullptr;
+            }
+            if (p.type != ProviderType::SHARED_FILE) {
+                if (entity.isMember("header") || entity.isMember("states")) {
+                    LOG(ERROR) << __func__ << ":" << entityWhat << " cannot configure states";
+                    return nullptr;
+                }
+                p.entities.push_back(e);
+                continue;
+            }
+
+            if (entity.isMember("header") &&
+                    !parseString(entity["header"], entityWhat + ".header", &e.header)) {
+                return nullptr;
+            }
+            const Json::Value &states = entity["states"];
+            if (states.isString()) {
+                if (!stateSets.isMember(states.asString())) {
+                    LOG(ERROR) << __func__ << ":" << entityWhat << " uses unknown state set "
+                               << states.asString();
+                    return nullptr;
+                }
+                if (!parseStates(stateSets[states.asString()],
+                                 "state_sets." + states.asString(), &e.states)) {
+                    return nullptr;
+                }
+            } else if (!parseStates(states, entityWhat + ".states", &e.states)) {
+                return nullptr;
+            }
+            p.entities.push_back(e);
+        }
+        config->mProviders.push_back(p);
+    }
+    return config;
+}
+
+void PowerStatsConfig::apply(WahooPowerStats *service, bool isDebuggable) const {
+    // Sources are only opened for the providers that are enabled.
+    std::vector<std::shared_ptr<SharedFileSource>> sources(mSources.size());
+
+    // Configured names were checked by load(); discovered ones can only be
+    // checked here, and lose to a configured entity of the same name.
+    std::set<std::string> entityNames;
+    for (const auto &provider : mProviders) {
+        for (const auto &entity : provider.entities) {
+            entityNames.insert(entity.name);
+        }
+    }
+    auto discovered = [&entityNames](const std::string &provider, const std::string &name) {
+        if (!entityNames.insert(name).second) {
+            LOG(ERROR) << "apply:" << provider << " skips duplicate entity " << name;
+            return false;
+        }
+        return true;
+    };
+
+    for (const auto &provider : mProviders) {
+        if (provider.debuggableOnly && !isDebuggable) {
+            continue;
+        }
+
+        switch (provider.type) {
+            case ProviderType::SHARED_FILE: {
+                auto &source = sources[provider.source];
+                if (!source) {
+                    const Source &s = mSources[provider.source];
+                    source = std::make_shared<SharedFileSource>(s.path, s.ttl);
+                }
+                sp<SharedFileStateResidencyDataProvider> sdp =
+                        new SharedFileStateResidencyDataProvider(source);
+                for (const auto &entity : provider.entities) {
+                    uint32_t id = service->addPowerEntity(entity.name, entity.type);
+                    sdp->addEntity(id, entity.header, entity.states);
+                }
+                service->addStateResidencyDataProvider(sdp, provider.name, provider.history);
+                break;
+            }
+            case ProviderType::WLAN: {
+                const Entity &entity = provider.entities[0];
+                uint32_t id = service->addPowerEntity(entity.name, entity.type);
+                service->addStateResidencyDataProvider(
+                        new WlanStateResidencyDataProvider(id, provider.path), provider.name,
+                        provider.history);
+                break;
+            }
+            case ProviderType::EASEL: {
+                const Entity &entity = provider.entities[0];
+                uint32_t id = service->addPowerEntity(entity.name, entity.type);
+                service->addStateResidencyDataProvider(
+                        new EaselStateResidencyDataProvider(id, provider.path), provider.name,
+                        provider.history);
+                break;
+            }
+            case ProviderType::CPU: {
+                sp<CpuStateResidencyDataProvider> sdp =
+                        new CpuStateResidencyDataProvider(provider.path);
+                for (size_t i = 0; i < sdp->entityCount(); i++) {
+                    if (discovered(provider.name, sdp->entityName(i))) {
+                        sdp->setPowerEntityId(i, service->addPowerEntity(
+                                sdp->entityName(i), PowerEntityType::POWER_DOMAIN));
+                    }
+                }
+                service->addStateResidencyDataProvider(sdp, provider.name, provider.history);
+                break;
+            }
+            case ProviderType::COOLING: {
+                sp<CoolingDeviceStateResidencyDataProvider> sdp =
+                        new CoolingDeviceStateResidencyDataProvider(provider.path,
+                                                                    provider.pollInterval);
+                for (size_t i = 0; i < sdp->deviceCount(); i++) {
+                    if (discovered(provider.name, sdp->deviceName(i))) {
+                        sdp->setPowerEntityId(i, service->addPowerEntity(
+                                sdp->deviceName(i), PowerEntityType::PERIPHERAL));
+                    }
+                }
+                sdp->start();
+                service->addStateResidencyDataProvider(sdp, provider.name, provider.history);
+                break;
+            }
+        }
+    }
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
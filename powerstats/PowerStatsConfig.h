@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_POWERSTATSCONFIG_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_POWERSTATSCONFIG_H
+
+#include <pixelpowerstats/GenericStateResidencyDataProvider.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "WahooPowerStats.h"
+
+using android::hardware::google::pixel::powerstats::StateResidencyConfig;
+using android::hardware::power::stats::V1_0::PowerEntityType;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Power entities and the providers that report them, read from a JSON file
+ * so subsystems can be added or their parsing changed without rebuilding
+ * the service. load() parses and validates the whole file before anything
+ * is registered; apply() registers the entities and providers.
+ *
+ *   {
+ *     "sources":    [ { "name": <id>, "path": <file>, "ttl_ms": <ms> } ],
+ *     "state_sets": { <id>: [ <state>, ... ] },
+ *     "providers":  [ { "name": <name>,
+ *                       "type": "shared_file" | "wlan" | "easel" | "cpu" |
+ *                               "cooling",
+ *                       "source": <source id>,        (shared_file)
+ *                       "path": <file>,               (wlan, cpu, cooling; optional
+ *                                                      for easel)
+ *                       "poll_ms": <ms>,              (cooling)
+ *                       "debuggable_only": <bool>,
+ *                       "history": <bool>,            (default true, false for wlan)
+ *                       "entities": [ { "name": <name>,
+ *                                       "type": "SUBSYSTEM" | "PERIPHERAL" |
+ *                                               "POWER_DOMAIN",
+ *                                       "header": <prefix>,
+ *                                       "states": <state set id> | [ <state>, ... ]
+ *                                     } ] } ]
+ *   }
+ *
+ * A cpu provider has no entities; it registers CPUCLn_IDLE and CPUCLn_FREQ
+ * for each CPU cluster found under its path. Likewise a cooling provider
+ * registers one per cooling device, re-reading their states every poll_ms
+ * (default 1000) and early on thermal uevents.
+ * A discovered name that is already taken is logged and not registered.
+ *
+ * where a state is
+ *
+ *   { "name": <name>, "header": <prefix>,
+ *     "entry_count" | "total_time" | "last_entry": { "prefix": <prefix>,
+ *                                                    "divisor": <n> } }
+ */
+class PowerStatsConfig {
+  public:
+    static std::unique_ptr<PowerStatsConfig> load(const std::string &path);
+    void apply(WahooPowerStats *service, bool isDebuggable) const;
+
+  private:
+    struct Source {
+        std::string name;
+        std::string path;
+        std::chrono::milliseconds ttl;
+    };
+    struct Entity {
+        std::string name;
+        PowerEntityType type;
+        std::string header;
+        std::vector<StateResidencyConfig> states;
+    };
+    enum class ProviderType { SHARED_FILE, WLAN, EASEL, CPU, COOLING };
+    struct Provider {
+        std::string name;
+        ProviderType type;
+        size_t source;  // index into mSources, SHARED_FILE only
+        std::string path;
+        std::chrono::milliseconds pollInterval;  // COOLING only
+        bool debuggableOnly;
+        bool history;  // sampled by the residency history
+        std::vector<Entity> entities;
+    };
+
+    std::vector<Source> mSources;
+    std::vector<Provider> mProviders;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_POWERSTATSCONFIG_H
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Loads arbitrary content as a power.stats config. Only load() runs: it
+ * validates the whole file, while apply() would start the providers.
+ */
+
+#include <android-base/file.h>
+
+#include "PowerStatsConfig.h"
+
+using android::device::google::wahoo::powerstats::PowerStatsConfig;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static TemporaryFile file;
+
+    if (android::base::WriteStringToFile(std::string(reinterpret_cast<const char *>(data), size),
+                                         file.path))
+        PowerStatsConfig::load(file.path);
+    return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerstatsstreamer"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <time.h>
+#include "PowerStatsStreamer.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+using ::vendor::google::wahoo::powerstats::V1_0::StreamConstant;
+using ::vendor::google::wahoo::powerstats::V1_0::StreamFlag;
+
+// About a minute of records at 100ms with 16 states per sample.
+static const size_t kQueueRecords = 8192;
+static const uint32_t kMinIntervalMs = 10;
+static const uint32_t kMaxDurationS = static_cast<uint32_t>(StreamConstant::MAX_DURATION_S);
+static const uint32_t kActiveStateId = static_cast<uint32_t>(StreamConstant::ACTIVE_STATE_ID);
+
+static uint64_t bootTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+// Counters only move forward; treat a reset as no activity.
+static uint64_t counterDelta(uint64_t cur, uint64_t prev) {
+    return cur >= prev ? cur - prev : 0;
+}
+
+PowerStatsStreamer::PowerStatsStreamer(sp<IStateResidencyDataProvider> collector)
+    : mCollector(collector), mRunning(false), mIntervalMs(0), mPrevMs(0), mEventFlag(nullptr),
+      mQueued(0), mDropped(0) {}
+
+PowerStatsStreamer::~PowerStatsStreamer() {
+    stopSampling();
+    if (mEventFlag) {
+        EventFlag::deleteEventFlag(&mEventFlag);
+    }
+}
+
+void PowerStatsStreamer::setEnergyModel(std::shared_ptr<const EnergyModel> model) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mEnergyModel = std::move(model);
+}
+
+Return<void> PowerStatsStreamer::start(uint32_t intervalMs, uint32_t durationS,
+                                       start_cb _hidl_cb) {
+    // Held until the descriptor is sent, so no other start() replaces mQueue.
+    std::lock_guard<std::mutex> control(mControlLock);
+    if (!startSampling(intervalMs, durationS)) {
+        _hidl_cb(false, DeltaQueue::Descriptor());
+        return Void();
+    }
+    _hidl_cb(true, *mQueue->getDesc());
+    return Void();
+}
+
+Return<void> PowerStatsStreamer::stop() {
+    stopSampling();
+    return Void();
+}
+
+bool PowerStatsStreamer::startSampling(uint32_t intervalMs, uint32_t durationS) {
+    if (durationS == 0 || durationS > kMaxDurationS) {
+        LOG(ERROR) << __func__ << ":Duration must be 1 to " << kMaxDurationS << " s";
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mRunning) {
+            LOG(ERROR) << __func__ << ":Streaming already running";
+            return false;
+        }
+    }
+    // A run that timed out has exited but not been joined.
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    {
+        // Nothing writes to the queue until the sampler below starts.
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        std::unique_ptr<DeltaQueue> queue(new DeltaQueue(kQueueRecords, true));
+        EventFlag *eventFlag = nullptr;
+        if (!queue->isValid() ||
+                EventFlag::createEventFlag(queue->getEventFlagWord(), &eventFlag) != OK) {
+            LOG(ERROR) << __func__ << ":Failed to create the stream queue";
+            return false;
+        }
+        if (mEventFlag) {
+            EventFlag::deleteEventFlag(&mEventFlag);
+        }
+        mQueue = std::move(queue);
+        mEventFlag = eventFlag;
+        mQueued = 0;
+        mDropped = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mIntervalMs = std::max(intervalMs, kMinIntervalMs);
+    mDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(durationS);
+    mRunning = true;
+    mPrev.clear();
+    mThread = std::thread(&PowerStatsStreamer::samplerLoop, this);
+    return true;
+}
+
+void PowerStatsStreamer::stopSampling() {
+    std::lock_guard<std::mutex> control(mControlLock);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+    }
+    mCv.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void PowerStatsStreamer::samplerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    auto next = std::chrono::steady_clock::now();
+
+    while (mRunning) {
+        if (std::chrono::steady_clock::now() >= mDeadline) {
+            LOG(INFO) << __func__ << ":Streaming duration reached, stopping";
+            mRunning = false;
+            break;
+        }
+        lock.unlock();
+        sample();
+        lock.lock();
+
+        next += std::chrono::milliseconds(mIntervalMs);
+        mCv.wait_until(lock, std::min(next, mDeadline), [this] { return !mRunning; });
+    }
+}
+
+void PowerStatsStreamer::sample() {
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+    std::shared_ptr<const EnergyModel> model;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        model = mEnergyModel;
+    }
+    mCollector->getResults(results);
+
+    uint64_t nowMs = bootTimeMs();
+    uint32_t intervalMs = nowMs - mPrevMs;
+    std::vector<PowerStatsDeltaRecord> records;
+
+    for (const auto &entry : results) {
+        uint64_t stateMs = 0;
+        bool havePrev = false;
+        for (const auto &data : entry.second.stateResidencyData) {
+            uint64_t key = static_cast<uint64_t>(entry.first) << 32 | data.powerEntityStateId;
+            auto prev = mPrev.find(key);
+            if (prev != mPrev.end()) {
+                uint64_t timeMs = counterDelta(data.totalTimeInStateMs,
+                                               prev->second.totalTimeInStateMs);
+                records.push_back({
+                    .timestampMs = nowMs,
+                    .intervalMs = intervalMs,
+                    .powerEntityId = entry.first,
+                    .powerEntityStateId = data.powerEntityStateId,
+                    .entryCountDelta = static_cast<uint32_t>(counterDelta(
+                            data.totalStateEntryCount, prev->second.totalStateEntryCount)),
+                    .timeInStateDeltaMs = timeMs,
+                    .energyUj = model ? model->stateEnergyUj(entry.first,
+                            data.powerEntityStateId, timeMs) : 0});
+                stateMs += timeMs;
+                havePrev = true;
+            }
+            mPrev[key] = data;
+        }
+
+        if (havePrev && model && model->hasEntity(entry.first)) {
+            uint64_t activeMs = intervalMs > stateMs ? intervalMs - stateMs : 0;
+            records.push_back({
+                .timestampMs = nowMs,
+                .intervalMs = intervalMs,
+                .powerEntityId = entry.first,
+                .powerEntityStateId = kActiveStateId,
+                .entryCountDelta = 0,
+                .timeInStateDeltaMs = activeMs,
+                .energyUj = model->activeEnergyUj(entry.first, activeMs)});
+        }
+    }
+    mPrevMs = nowMs;
+
+    if (!records.empty()) {
+        queue(records);
+    }
+}
+
+// A sample is queued whole or not at all.
+void PowerStatsStreamer::queue(const std::vector<PowerStatsDeltaRecord> &records) {
+    std::lock_guard<std::mutex> lock(mQueueLock);
+    if (!mQueue->write(records.data(), records.size())) {
+        mDropped += records.size();
+        return;
+    }
+    mQueued += records.size();
+    mEventFlag->wake(static_cast<uint32_t>(StreamFlag::NOT_EMPTY));
+}
+
+void PowerStatsStreamer::dumpStatus(int fd) {
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mRunning) {
+            auto left = std::chrono::duration_cast<std::chrono::seconds>(
+                    mDeadline - std::chrono::steady_clock::now());
+            out = android::base::StringPrintf("streaming every %" PRIu32 " ms for %" PRId64
+                                              " more s", mIntervalMs,
+                                              static_cast<int64_t>(left.count()));
+        } else {
+            out = "streaming stopped";
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        if (mQueue) {
+            android::base::StringAppendF(&out, ", %zu/%zu unread, %" PRIu64 " written, %" PRIu64
+                                         " dropped\n", mQueue->availableToRead(),
+                                         mQueue->getQuantumCount(), mQueued, mDropped);
+        } else {
+            out += ", no client queue\n";
+        }
+    }
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_POWERSTATSSTREAMER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_POWERSTATSSTREAMER_H
+
+#include <fmq/EventFlag.h>
+#include <fmq/MessageQueue.h>
+#include <pixelpowerstats/PowerStats.h>
+#include <vendor/google/wahoo/powerstats/1.0/IPowerStatsStream.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "EnergyModel.h"
+
+using android::hardware::EventFlag;
+using android::hardware::kSynchronizedReadWrite;
+using android::hardware::MessageQueue;
+using android::hardware::Return;
+using android::hardware::Void;
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyData;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using ::vendor::google::wahoo::powerstats::V1_0::IPowerStatsStream;
+using ::vendor::google::wahoo::powerstats::V1_0::PowerStatsDeltaRecord;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * IPowerStatsStream: samples the residency collector at a fixed interval and
+ * writes the per-state deltas to a synchronized FMQ handed to the client by
+ * start(). Every run has a duration after which it stops by itself, so a
+ * forgotten session cannot keep waking the device. When the queue is full,
+ * new samples are dropped and counted.
+ */
+class PowerStatsStreamer : public IPowerStatsStream {
+  public:
+    // |collector| is queried for every sample, normally the
+    // ParallelStateResidencyDataProvider holding all providers.
+    explicit PowerStatsStreamer(sp<IStateResidencyDataProvider> collector);
+    ~PowerStatsStreamer();
+    void setEnergyModel(std::shared_ptr<const EnergyModel> model);
+    void dumpStatus(int fd);
+
+    // Methods from ::vendor::google::wahoo::powerstats::V1_0::IPowerStatsStream follow.
+    Return<void> start(uint32_t intervalMs, uint32_t durationS, start_cb _hidl_cb) override;
+    Return<void> stop() override;
+
+  private:
+    using DeltaQueue = MessageQueue<PowerStatsDeltaRecord, kSynchronizedReadWrite>;
+
+    // Called with mControlLock held.
+    bool startSampling(uint32_t intervalMs, uint32_t durationS);
+    void stopSampling();
+    void samplerLoop();
+    void sample();
+    void queue(const std::vector<PowerStatsDeltaRecord> &records);
+
+    const sp<IStateResidencyDataProvider> mCollector;
+
+    // Serializes start() and stop(), which join the sampler.
+    std::mutex mControlLock;
+    std::mutex mLock;
+    std::condition_variable mCv;
+    bool mRunning;
+    uint32_t mIntervalMs;
+    std::chrono::steady_clock::time_point mDeadline;
+    std::thread mThread;
+    std::shared_ptr<const EnergyModel> mEnergyModel;
+
+    // Previous sample, keyed by entity id << 32 | state id. Sampler only.
+    std::unordered_map<uint64_t, PowerEntityStateResidencyData> mPrev;
+    uint64_t mPrevMs;
+
+    // Replaced by every start(); the client of the previous run keeps its own
+    // mapping of the old queue.
+    std::mutex mQueueLock;
+    std::unique_ptr<DeltaQueue> mQueue;
+    EventFlag *mEventFlag;
+    uint64_t mQueued;
+    uint64_t mDropped;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_POWERSTATSSTREAMER_H
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "ResidencyHistory.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static constexpr char kMagic[] = "WPH1";
+static constexpr size_t kMagicLen = sizeof(kMagic) - 1;
+
+static void putVarint(uint64_t v, std::string *out) {
+    while (v >= 0x80) {
+        out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out->push_back(static_cast<char>(v));
+}
+
+// Counters can reset (e.g. a subsystem restart), so deltas are zigzag encoded.
+static void putSigned(int64_t v, std::string *out) {
+    putVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63), out);
+}
+
+static void putString(const std::string &s, std::string *out) {
+    putVarint(s.size(), out);
+    out->append(s);
+}
+
+static bool getVarint(const std::string &in, size_t end, size_t *pos, uint64_t *v) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *pos < end; shift += 7) {
+        uint8_t b = in[(*pos)++];
+        result |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool getSigned(const std::string &in, size_t end, size_t *pos, int64_t *v) {
+    uint64_t u;
+    if (!getVarint(in, end, pos, &u)) {
+        return false;
+    }
+    *v = static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+    return true;
+}
+
+static bool getString(const std::string &in, size_t *pos, std::string *s) {
+    uint64_t len;
+    if (!getVarint(in, in.size(), pos, &len) || len > in.size() - *pos) {
+        return false;
+    }
+    s->assign(in, *pos, len);
+    *pos += len;
+    return true;
+}
+
+static bool sameStates(const HistorySample &a, const HistorySample &b) {
+    if (a.values.size() != b.values.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.values.size(); i++) {
+        if (a.values[i].powerEntityId != b.values[i].powerEntityId ||
+                a.values[i].powerEntityStateId != b.values[i].powerEntityStateId) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void putKeyframe(const HistorySample &sample, std::string *out) {
+    out->clear();
+    putVarint(sample.timestampMs, out);
+    putVarint(sample.values.size(), out);
+    for (const auto &value : sample.values) {
+        putVarint(value.powerEntityId, out);
+        putVarint(value.powerEntityStateId, out);
+        putVarint(value.totalStateEntryCount, out);
+        putVarint(value.totalTimeInStateMs, out);
+    }
+}
+
+static void putDelta(const HistorySample &prev, const HistorySample &cur, std::string *out) {
+    out->clear();
+    putSigned(cur.timestampMs - prev.timestampMs, out);
+    for (size_t i = 0; i < cur.values.size(); i++) {
+        putSigned(cur.values[i].totalStateEntryCount - prev.values[i].totalStateEntryCount, out);
+        putSigned(cur.values[i].totalTimeInStateMs - prev.values[i].totalTimeInStateMs, out);
+    }
+}
+
+static bool decodeBlock(const std::string &data, size_t end, size_t *pos,
+                        std::vector<HistorySample> *samples) {
+    HistorySample sample;
+    uint64_t count;
+    if (!getVarint(data, end, pos, &sample.timestampMs) || !getVarint(data, end, pos, &count) ||
+            count > end - *pos) {
+        return false;
+    }
+    sample.values.resize(count);
+    for (auto &value : sample.values) {
+        uint64_t entity, state;
+        if (!getVarint(data, end, pos, &entity) || !getVarint(data, end, pos, &state) ||
+                !getVarint(data, end, pos, &value.totalStateEntryCount) ||
+                !getVarint(data, end, pos, &value.totalTimeInStateMs)) {
+            return false;
+        }
+        value.powerEntityId = entity;
+        value.powerEntityStateId = state;
+    }
+    samples->push_back(sample);
+
+    while (*pos < end) {
+        int64_t delta;
+        if (!getSigned(data, end, pos, &delta)) {
+            return false;
+        }
+        sample.timestampMs += delta;
+        for (auto &value : sample.values) {
+            int64_t countDelta, timeDelta;
+            if (!getSigned(data, end, pos, &countDelta) ||
+                    !getSigned(data, end, pos, &timeDelta)) {
+                return false;
+            }
+            value.totalStateEntryCount += countDelta;
+            value.totalTimeInStateMs += timeDelta;
+        }
+        samples->push_back(sample);
+    }
+    return true;
+}
+
+size_t ResidencyHistory::blocksFor(uint32_t intervalMs, uint64_t retentionMs) {
+    uint64_t blockMs = static_cast<uint64_t>(std::max<uint32_t>(intervalMs, 1)) * kSamplesPerBlock;
+    return (retentionMs + blockMs - 1) / blockMs + 1;
+}
+
+ResidencyHistory::ResidencyHistory(size_t blockCount) : mHead(0), mUsed(0), mHaveLast(false) {
+    mBlocks.resize(std::max<size_t>(blockCount, 1));
+    for (auto &block : mBlocks) {
+        block.samples = 0;
+        block.firstMs = 0;
+    }
+}
+
+// The keyframe is in mScratch.
+void ResidencyHistory::startBlock(uint64_t timestampMs) {
+    if (mUsed > 0) {
+        mHead = (mHead + 1) % mBlocks.size();
+    }
+    mUsed = std::min(mUsed + 1, mBlocks.size());
+
+    // assign() keeps the capacity of the dropped block's buffer.
+    Block &block = mBlocks[mHead];
+    block.data.assign(mScratch);
+    block.samples = 1;
+    block.firstMs = timestampMs;
+}
+
+void ResidencyHistory::append(const HistorySample &sample) {
+    if (mHaveLast && sameStates(mLast, sample) && mBlocks[mHead].samples < kSamplesPerBlock) {
+        Block &block = mBlocks[mHead];
+        putDelta(mLast, sample, &mScratch);
+        block.data.append(mScratch);
+        block.samples++;
+        mLast = sample;
+        return;
+    }
+
+    putKeyframe(sample, &mScratch);
+    startBlock(sample.timestampMs);
+    mLast = sample;
+    mHaveLast = true;
+}
+
+size_t ResidencyHistory::sampleCount() const {
+    size_t count = 0;
+    for (const auto &block : mBlocks) {
+        count += block.samples;
+    }
+    return count;
+}
+
+size_t ResidencyHistory::bytesUsed() const {
+    size_t bytes = 0;
+    for (const auto &block : mBlocks) {
+        bytes += block.data.size();
+    }
+    return bytes;
+}
+
+size_t ResidencyHistory::sampleCapacity() const {
+    return mBlocks.size() * kSamplesPerBlock;
+}
+
+bool ResidencyHistory::span(uint64_t *firstMs, uint64_t *lastMs) const {
+    if (!mHaveLast) {
+        return false;
+    }
+    *firstMs = mBlocks[(mHead + mBlocks.size() - mUsed + 1) % mBlocks.size()].firstMs;
+    *lastMs = mLast.timestampMs;
+    return true;
+}
+
+void ResidencyHistory::serialize(const HistoryNames &names, uint64_t realtimeMs,
+                                 uint64_t boottimeMs, std::string *out) const {
+    out->assign(kMagic, kMagicLen);
+    putVarint(realtimeMs, out);
+    putVarint(boottimeMs, out);
+
+    putVarint(names.entities.size(), out);
+    for (const auto &entity : names.entities) {
+        putVarint(entity.first, out);
+        putString(entity.second, out);
+    }
+    putVarint(names.states.size(), out);
+    for (const auto &state : names.states) {
+        putVarint(state.first.first, out);
+        putVarint(state.first.second, out);
+        putString(state.second, out);
+    }
+
+    putVarint(mUsed, out);
+    for (size_t i = 0; i < mUsed; i++) {
+        const Block &block = mBlocks[(mHead + mBlocks.size() - mUsed + 1 + i) % mBlocks.size()];
+        putString(block.data, out);
+    }
+}
+
+bool ResidencyHistory::decode(const std::string &data, HistoryNames *names, uint64_t *realtimeMs,
+                              uint64_t *boottimeMs, std::vector<HistorySample> *samples) {
+    samples->clear();
+    if (data.compare(0, kMagicLen, kMagic) != 0) {
+        return false;
+    }
+
+    size_t pos = kMagicLen;
+    uint64_t count;
+    if (!getVarint(data, data.size(), &pos, realtimeMs) ||
+            !getVarint(data, data.size(), &pos, boottimeMs) ||
+            !getVarint(data, data.size(), &pos, &count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t id;
+        std::string name;
+        if (!getVarint(data, data.size(), &pos, &id) || !getString(data, &pos, &name)) {
+            return false;
+        }
+        names->entities[id] = name;
+    }
+    if (!getVarint(data, data.size(), &pos, &count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t entity, state;
+        std::string name;
+        if (!getVarint(data, data.size(), &pos, &entity) ||
+                !getVarint(data, data.size(), &pos, &state) || !getString(data, &pos, &name)) {
+            return false;
+        }
+        names->states[{entity, state}] = name;
+    }
+
+    if (!getVarint(data, data.size(), &pos, &count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t len;
+        if (!getVarint(data, data.size(), &pos, &len) || len > data.size() - pos) {
+            return false;
+        }
+        size_t end = pos + len;
+        if (!decodeBlock(data, end, &pos, samples)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
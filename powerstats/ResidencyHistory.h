@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_RESIDENCYHISTORY_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_RESIDENCYHISTORY_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+// Cumulative residency of one state at one sample.
+struct HistoryValue {
+    uint32_t powerEntityId;
+    uint32_t powerEntityStateId;
+    uint64_t totalStateEntryCount;
+    uint64_t totalTimeInStateMs;
+};
+
+struct HistorySample {
+    uint64_t timestampMs;  // CLOCK_BOOTTIME
+    std::vector<HistoryValue> values;
+};
+
+struct HistoryNames {
+    std::map<uint32_t, std::string> entities;
+    std::map<std::pair<uint32_t, uint32_t>, std::string> states;
+};
+
+/*
+ * Ring of residency samples. The ring is a set of blocks holding up to
+ * kSamplesPerBlock samples each; a block starts with a keyframe holding the
+ * state list and absolute values, followed by samples delta and varint
+ * encoded against the previous one. When the current block is full, or the
+ * state list changes, a new block is started, and once all blocks are in
+ * use the oldest is dropped.
+ *
+ * Blocks are counted in samples rather than bytes, so the span kept does
+ * not depend on how well the residency compresses: with one sample per
+ * interval, blocksFor() gives the block count that always keeps the wanted
+ * span. Only state list changes, which close a block early, shorten it.
+ * Memory follows the encoded samples: a keyframe per block and a few bytes
+ * per state for every other sample. Block buffers are reused once the ring
+ * wraps.
+ *
+ * Export layout: magic, realtime and boottime at export, the entity and
+ * state names, then each block as a length-prefixed byte string, oldest
+ * first. The decoder only needs this file and the standard library.
+ */
+class ResidencyHistory {
+  public:
+    static constexpr size_t kSamplesPerBlock = 60;
+
+    // Blocks needed to always keep |retentionMs| of samples taken every
+    // |intervalMs|: the oldest block is dropped as a new one starts, so one
+    // more than the span fills.
+    static size_t blocksFor(uint32_t intervalMs, uint64_t retentionMs);
+
+    explicit ResidencyHistory(size_t blockCount);
+    void append(const HistorySample &sample);
+    size_t sampleCount() const;
+    // Samples the ring can hold if no block is closed early.
+    size_t sampleCapacity() const;
+    size_t bytesUsed() const;
+    // Oldest and newest sample timestamps; false if the ring is empty.
+    bool span(uint64_t *firstMs, uint64_t *lastMs) const;
+
+    void serialize(const HistoryNames &names, uint64_t realtimeMs, uint64_t boottimeMs,
+                   std::string *out) const;
+    static bool decode(const std::string &data, HistoryNames *names, uint64_t *realtimeMs,
+                       uint64_t *boottimeMs, std::vector<HistorySample> *samples);
+
+  private:
+    struct Block {
+        std::string data;
+        size_t samples;
+        uint64_t firstMs;
+    };
+
+    void startBlock(uint64_t timestampMs);
+
+    std::vector<Block> mBlocks;
+    size_t mHead;  // block being appended to
+    size_t mUsed;  // blocks holding samples
+    std::string mScratch;  // sample being encoded
+    bool mHaveLast;
+    HistorySample mLast;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_RESIDENCYHISTORY_H
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Decodes a residency history exported by the power.stats service and shows
+ * when each low power state last accrued time.
+ *
+ *   adb shell lshal debug android.hardware.power.stats@1.0::IPowerStats/default \
+ *       --history > history.bin
+ *   residency_history_reader [-v] history.bin
+ */
+
+#include <android-base/file.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#include "ResidencyHistory.h"
+
+using android::device::google::wahoo::powerstats::HistoryNames;
+using android::device::google::wahoo::powerstats::HistorySample;
+using android::device::google::wahoo::powerstats::ResidencyHistory;
+
+static std::string stateName(const HistoryNames &names, uint32_t entity, uint32_t state) {
+    auto e = names.entities.find(entity);
+    auto s = names.states.find({entity, state});
+    std::string name = e != names.entities.end() ? e->second : std::to_string(entity);
+    return name + "." + (s != names.states.end() ? s->second : std::to_string(state));
+}
+
+static std::string wallTime(uint64_t realtimeMs, uint64_t boottimeMs, uint64_t sampleMs) {
+    char when[32];
+    time_t t = (realtimeMs - (boottimeMs - sampleMs)) / 1000;
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+    return when;
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 2 && !strcmp(argv[1], "-v");
+    if (argc != (verbose ? 3 : 2)) {
+        fprintf(stderr, "usage: %s [-v] <history file>\n", argv[0]);
+        return 1;
+    }
+
+    std::string data;
+    if (!android::base::ReadFileToString(argv[argc - 1], &data)) {
+        perror(argv[argc - 1]);
+        return 1;
+    }
+
+    HistoryNames names;
+    uint64_t realtimeMs = 0, boottimeMs = 0;
+    std::vector<HistorySample> samples;
+    if (!ResidencyHistory::decode(data, &names, &realtimeMs, &boottimeMs, &samples))
+        fprintf(stderr, "warning: file is truncated or corrupt after %zu samples\n",
+                samples.size());
+    if (samples.size() < 2) {
+        fprintf(stderr, "not enough samples\n");
+        return 1;
+    }
+
+    const HistorySample &first = samples.front();
+    const HistorySample &last = samples.back();
+    printf("samples:  %zu\n", samples.size());
+    printf("span:     %s - %s (%.1f h)\n\n",
+           wallTime(realtimeMs, boottimeMs, first.timestampMs).c_str(),
+           wallTime(realtimeMs, boottimeMs, last.timestampMs).c_str(),
+           (last.timestampMs - first.timestampMs) / 3600000.0);
+
+    // Per state: time accrued over the history, the last interval in which
+    // it accrued any, and the longest stretch in which it accrued none.
+    struct Summary {
+        uint64_t totalMs = 0;
+        uint64_t lastAccruedMs = 0;
+        uint64_t idleSinceMs = 0;
+        uint64_t longestIdleMs = 0;
+    };
+    std::map<std::pair<uint32_t, uint32_t>, Summary> summaries;
+
+    if (verbose)
+        printf("%-20s  %s\n", "time", "state +entries/+ms");
+    for (size_t i = 1; i < samples.size(); i++) {
+        const HistorySample &prev = samples[i - 1];
+        const HistorySample &cur = samples[i];
+        if (verbose)
+            printf("%-20s ", wallTime(realtimeMs, boottimeMs, cur.timestampMs).c_str());
+
+        for (const auto &value : cur.values) {
+            auto key = std::make_pair(value.powerEntityId, value.powerEntityStateId);
+            Summary &summary = summaries[key];
+            if (!summary.idleSinceMs)
+                summary.idleSinceMs = first.timestampMs;
+
+            uint64_t deltaMs = 0, deltaCount = 0;
+            for (const auto &p : prev.values) {
+                if (p.powerEntityId == value.powerEntityId &&
+                    p.powerEntityStateId == value.powerEntityStateId) {
+                    if (value.totalTimeInStateMs >= p.totalTimeInStateMs)
+                        deltaMs = value.totalTimeInStateMs - p.totalTimeInStateMs;
+                    if (value.totalStateEntryCount >= p.totalStateEntryCount)
+                        deltaCount = value.totalStateEntryCount - p.totalStateEntryCount;
+                    break;
+                }
+            }
+
+            summary.totalMs += deltaMs;
+            if (deltaMs) {
+                summary.lastAccruedMs = cur.timestampMs;
+                summary.idleSinceMs = cur.timestampMs;
+            } else {
+                summary.longestIdleMs = std::max(summary.longestIdleMs,
+                                                 cur.timestampMs - summary.idleSinceMs);
+            }
+            if (verbose && (deltaMs || deltaCount))
+                printf(" %s +%" PRIu64 "/+%" PRIu64,
+                       stateName(names, key.first, key.second).c_str(), deltaCount, deltaMs);
+        }
+        if (verbose)
+            printf("\n");
+    }
+    if (verbose)
+        printf("\n");
+
+    printf("%-24s %12s %8s  %-20s %12s\n", "state", "time(s)", "share", "last accrued",
+           "longest gap");
+    double spanMs = last.timestampMs - first.timestampMs;
+    for (const auto &entry : summaries) {
+        const Summary &summary = entry.second;
+        std::string lastAccrued = summary.lastAccruedMs
+                ? wallTime(realtimeMs, boottimeMs, summary.lastAccruedMs)
+                : "never";
+        printf("%-24s %12.1f %7.1f%%  %-20s %10.1f h\n",
+               stateName(names, entry.first.first, entry.first.second).c_str(),
+               summary.totalMs / 1000.0, 100.0 * summary.totalMs / spanMs, lastAccrued.c_str(),
+               summary.longestIdleMs / 3600000.0);
+    }
+    return 0;
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "residencyhistory"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <time.h>
+#include <algorithm>
+#include "ResidencyHistoryRecorder.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static uint64_t clockMs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+ResidencyHistoryRecorder::ResidencyHistoryRecorder()
+    : mRunning(false), mIntervalMs(0), mRetentionMs(0) {}
+
+ResidencyHistoryRecorder::~ResidencyHistoryRecorder() {
+    stop();
+}
+
+void ResidencyHistoryRecorder::setEntityName(uint32_t powerEntityId, const std::string &name) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mNames.entities[powerEntityId] = name;
+}
+
+void ResidencyHistoryRecorder::addStateResidencyDataProvider(sp<IStateResidencyDataProvider> p) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mProviders.push_back(p);
+}
+
+bool ResidencyHistoryRecorder::start(uint32_t intervalMs, uint64_t retentionMs) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (mRunning) {
+        LOG(ERROR) << __func__ << ":History already running";
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> historyLock(mHistoryLock);
+        if (!mHistory) {
+            mHistory.reset(new ResidencyHistory(
+                    ResidencyHistory::blocksFor(intervalMs, retentionMs)));
+        }
+    }
+    mIntervalMs = intervalMs;
+    mRetentionMs = retentionMs;
+    mRunning = true;
+    mThread = std::thread(&ResidencyHistoryRecorder::recorderLoop, this);
+    return true;
+}
+
+void ResidencyHistoryRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+    }
+    mCv.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void ResidencyHistoryRecorder::recorderLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    auto next = std::chrono::steady_clock::now();
+
+    while (mRunning) {
+        lock.unlock();
+        sample();
+        lock.lock();
+
+        next += std::chrono::milliseconds(mIntervalMs);
+        mCv.wait_until(lock, next, [this] { return !mRunning; });
+    }
+}
+
+void ResidencyHistoryRecorder::sample() {
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+    std::vector<sp<IStateResidencyDataProvider>> providers;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        providers = mProviders;
+    }
+    for (const auto &provider : providers) {
+        provider->getResults(results);
+    }
+    // An entity whose provider failed this time keeps its last values, so a
+    // transient failure shows as no progress rather than changing the state
+    // list and forcing a keyframe on both sides of it.
+    for (const auto &entry : mLastResults) {
+        results.insert(entry);
+    }
+    mLastResults = results;
+
+    // Keep a stable order so consecutive samples share a state list and
+    // encode as deltas.
+    HistorySample sample = {.timestampMs = clockMs(CLOCK_BOOTTIME)};
+    for (const auto &entry : results) {
+        for (const auto &data : entry.second.stateResidencyData) {
+            sample.values.push_back({.powerEntityId = entry.first,
+                                     .powerEntityStateId = data.powerEntityStateId,
+                                     .totalStateEntryCount = data.totalStateEntryCount,
+                                     .totalTimeInStateMs = data.totalTimeInStateMs});
+        }
+    }
+    std::sort(sample.values.begin(), sample.values.end(),
+              [](const HistoryValue &a, const HistoryValue &b) {
+                  return a.powerEntityId != b.powerEntityId
+                                 ? a.powerEntityId < b.powerEntityId
+                                 : a.powerEntityStateId < b.powerEntityStateId;
+              });
+
+    std::lock_guard<std::mutex> lock(mHistoryLock);
+    mHistory->append(sample);
+}
+
+bool ResidencyHistoryRecorder::dump(int fd) {
+    HistoryNames names;
+    std::vector<sp<IStateResidencyDataProvider>> providers;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        names = mNames;
+        providers = mProviders;
+    }
+    // State names are looked up at dump time since the AIDL provider learns
+    // its entities after registration.
+    for (const auto &provider : providers) {
+        for (const auto &space : provider->getStateSpaces()) {
+            for (const auto &state : space.states) {
+                names.states[{space.powerEntityId, state.powerEntityStateId}] =
+                        state.powerEntityStateName;
+            }
+        }
+    }
+
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(mHistoryLock);
+        if (!mHistory) {
+            LOG(ERROR) << __func__ << ":History was never started";
+            return false;
+        }
+        mHistory->serialize(names, clockMs(CLOCK_REALTIME), clockMs(CLOCK_BOOTTIME), &out);
+    }
+    if (!android::base::WriteFully(fd, out.data(), out.size())) {
+        PLOG(ERROR) << __func__ << ":Failed to write history";
+        return false;
+    }
+    return true;
+}
+
+void ResidencyHistoryRecorder::dumpStatus(int fd) {
+    std::string out;
+    uint32_t intervalMs;
+    uint64_t retentionMs;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        intervalMs = mRunning ? mIntervalMs : 0;
+        retentionMs = mRetentionMs;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mHistoryLock);
+        uint64_t firstMs, lastMs;
+        if (!mHistory) {
+            out = "not started\n";
+        } else {
+            if (!mHistory->span(&firstMs, &lastMs)) {
+                firstMs = lastMs = 0;
+            }
+            // The span only reaches the retention once the ring has wrapped.
+            out = android::base::StringPrintf("%zu/%zu samples every %" PRIu32 " ms over "
+                                              "%.1f h of %.1f h retention, %zu bytes\n",
+                                              mHistory->sampleCount(),
+                                              mHistory->sampleCapacity(), intervalMs,
+                                              (lastMs - firstMs) / 3600000.0,
+                                              retentionMs / 3600000.0, mHistory->bytesUsed());
+        }
+    }
+    android::base::WriteStringToFd(out, fd);
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_RESIDENCYHISTORYRECORDER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_RESIDENCYHISTORYRECORDER_H
+
+#include <pixelpowerstats/PowerStats.h>
+
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include "ResidencyHistory.h"
+
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Samples every registered provider at a fixed interval into a
+ * ResidencyHistory, so a drain regression can be traced back to the minute
+ * a low power state stopped being reached. The interval is measured on the
+ * monotonic clock, so no samples are taken while suspended; the next sample
+ * picks up the residency accrued meanwhile.
+ *
+ * Providers that are expensive to poll, such as WLAN whose debugfs node
+ * queries the firmware, are left out unless the config opts them in.
+ */
+class ResidencyHistoryRecorder {
+  public:
+    ResidencyHistoryRecorder();
+    ~ResidencyHistoryRecorder();
+    void setEntityName(uint32_t powerEntityId, const std::string &name);
+    void addStateResidencyDataProvider(sp<IStateResidencyDataProvider> p);
+    // Samples every |intervalMs|. The first start() sizes the history to
+    // keep |retentionMs|.
+    bool start(uint32_t intervalMs, uint64_t retentionMs);
+    void stop();
+    // Writes the history in the ResidencyHistory export format.
+    bool dump(int fd);
+    void dumpStatus(int fd);
+
+  private:
+    void recorderLoop();
+    void sample();
+
+    std::mutex mLock;
+    std::condition_variable mCv;
+    bool mRunning;
+    uint32_t mIntervalMs;
+    uint64_t mRetentionMs;
+    std::thread mThread;
+    std::vector<sp<IStateResidencyDataProvider>> mProviders;
+    HistoryNames mNames;
+    // Recorder thread only.
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> mLastResults;
+
+    std::mutex mHistoryLock;
+    std::unique_ptr<ResidencyHistory> mHistory;  // created by the first start()
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_RESIDENCYHISTORYRECORDER_H
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_SEQLOCK_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_SEQLOCK_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Publishes a trivially copyable snapshot from one writer to any number of
+ * readers. Readers never block: they copy the value and retry if a write
+ * overlapped. The value is kept as relaxed atomic words so that the racy
+ * copy is well defined.
+ *
+ * Only one thread may call write() at a time; callers with several
+ * writers have to serialize them.
+ */
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable T");
+
+  public:
+    Seqlock() : mSeq(0) {
+        for (auto &word : mWords)
+            word.store(0, std::memory_order_relaxed);
+    }
+
+    explicit Seqlock(const T &value) : Seqlock() { write(value); }
+
+    void write(const T &value) {
+        uint64_t words[kWords] = {};
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t seq = mSeq.load(std::memory_order_relaxed);
+        mSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; i++)
+            mWords[i].store(words[i], std::memory_order_relaxed);
+        mSeq.store(seq + 2, std::memory_order_release);
+    }
+
+    T read() const {
+        uint64_t words[kWords];
+        uint32_t seq;
+
+        do {
+            seq = mSeq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < kWords; i++)
+                words[i] = mWords[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != mSeq.load(std::memory_order_relaxed));
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+  private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // Odd while write() is storing the words.
+    std::atomic<uint32_t> mSeq;
+    std::atomic<uint64_t> mWords[kWords];
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_SEQLOCK_H
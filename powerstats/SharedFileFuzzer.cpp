@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds arbitrary system_stats content to the RPM and SoC providers set up
+ * as in powerstats_config.json. The providers persist across inputs, so
+ * lookup hints left by one file are checked against the next.
+ */
+
+#include <android-base/file.h>
+
+#include "SharedFileStateResidencyDataProvider.h"
+
+using android::sp;
+using android::device::google::wahoo::powerstats::SharedFileSource;
+using android::device::google::wahoo::powerstats::SharedFileStateResidencyDataProvider;
+
+static sp<SharedFileStateResidencyDataProvider> makeRpm(std::shared_ptr<SharedFileSource> source) {
+    std::vector<StateResidencyConfig> configs = {
+        {.name = "XO_shutdown",
+         .entryCountSupported = true,
+         .entryCountPrefix = "XO Count:",
+         .totalTimeSupported = true,
+         .totalTimePrefix = "Accumulated XO duration:",
+         .totalTimeTransform = [](uint64_t a) { return a / 19200; }}};
+
+    sp<SharedFileStateResidencyDataProvider> rpm =
+            new SharedFileStateResidencyDataProvider(source);
+    uint32_t id = 0;
+    for (const char *master : {"APSS", "MPSS", "ADSP", "SLPI"})
+        rpm->addEntity(id++, master, configs);
+    return rpm;
+}
+
+static sp<SharedFileStateResidencyDataProvider> makeSoc(std::shared_ptr<SharedFileSource> source) {
+    std::vector<StateResidencyConfig> configs;
+    for (const char *mode : {"vlow", "vmin"}) {
+        configs.push_back({.name = mode,
+                           .header = std::string("RPM Mode:") + mode,
+                           .entryCountSupported = true,
+                           .entryCountPrefix = "count:",
+                           .totalTimeSupported = true,
+                           .totalTimePrefix = "actual last sleep(msec):"});
+    }
+
+    sp<SharedFileStateResidencyDataProvider> soc =
+            new SharedFileStateResidencyDataProvider(source);
+    soc->addEntity(4, configs);
+    return soc;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static TemporaryFile file;
+    // No TTL, so every input is read and split again.
+    static auto source = std::make_shared<SharedFileSource>(file.path,
+                                                            std::chrono::milliseconds(0));
+    static sp<SharedFileStateResidencyDataProvider> rpm = makeRpm(source);
+    static sp<SharedFileStateResidencyDataProvider> soc = makeSoc(source);
+
+    if (!android::base::WriteStringToFile(std::string(reinterpret_cast<const char *>(data), size),
+                                          file.path))
+        return 0;
+
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+    rpm->getResults(results);
+    soc->getResults(results);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "sharedfilesource"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include "SharedFileSource.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+SharedFileSource::SharedFileSource(const std::string &path, std::chrono::milliseconds ttl) :
+    mPath(path), mTtl(ttl) {}
+
+std::shared_ptr<const FileSnapshot> SharedFileSource::get() {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    auto now = std::chrono::steady_clock::now();
+    if (mSnapshot && now - mReadTime < mTtl) {
+        return mSnapshot;
+    }
+
+    auto snapshot = std::make_shared<FileSnapshot>();
+    if (!android::base::ReadFileToString(mPath, &snapshot->data)) {
+        PLOG(ERROR) << __func__ << ":Failed to read " << mPath;
+        return nullptr;
+    }
+
+    std::string_view rest(snapshot->data);
+    while (!rest.empty()) {
+        size_t eol = rest.find('\n');
+        std::string_view line = rest.substr(0, eol);
+        rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string_view::npos) {
+            snapshot->lines.push_back(line.substr(start));
+        }
+    }
+
+    mSnapshot = std::move(snapshot);
+    mReadTime = now;
+    return mSnapshot;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
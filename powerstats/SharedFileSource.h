@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_SHAREDFILESOURCE_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_SHAREDFILESOURCE_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * One read of a stats file, split into lines with leading whitespace
+ * removed. The views point into |data|.
+ */
+struct FileSnapshot {
+    std::string data;
+    std::vector<std::string_view> lines;
+};
+
+/*
+ * Reads a file on behalf of several providers. A snapshot younger than the
+ * TTL is handed out again instead of reading the file, so all providers
+ * queried within one power.stats call share one read and one line split.
+ */
+class SharedFileSource {
+  public:
+    SharedFileSource(const std::string &path, std::chrono::milliseconds ttl);
+    std::shared_ptr<const FileSnapshot> get();
+    const std::string &path() const { return mPath; }
+
+  private:
+    std::mutex mLock;
+    const std::string mPath;
+    const std::chrono::milliseconds mTtl;
+    std::shared_ptr<const FileSnapshot> mSnapshot;
+    std::chrono::steady_clock::time_point mReadTime;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_SHAREDFILESOURCE_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "sharedfilestateresidency"
+
+#include <android-base/logging.h>
+#include "SharedFileStateResidencyDataProvider.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+// Index of the first line in [start, end) that begins with |prefix|, or
+// |end| if there is none.
+static size_t findLine(const std::vector<std::string_view> &lines, size_t start, size_t end,
+                       std::string_view prefix) {
+    for (size_t i = start; i < end; i++) {
+        if (lines[i].compare(0, prefix.size(), prefix) == 0) {
+            return i;
+        }
+    }
+    return end;
+}
+
+// Parses the number following |prefix| on |line|.
+static bool parseValue(std::string_view line, size_t prefixLen, uint64_t *value) {
+    // The views are not NUL terminated, so bound the number by the line.
+    std::string_view rest = line.substr(prefixLen);
+    size_t begin = rest.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        return false;
+    }
+    uint64_t result = 0;
+    size_t n = begin;
+    for (; n < rest.size() && rest[n] >= '0' && rest[n] <= '9'; n++) {
+        result = result * 10 + (rest[n] - '0');
+    }
+    if (n == begin) {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+
+SharedFileStateResidencyDataProvider::SharedFileStateResidencyDataProvider(
+        std::shared_ptr<SharedFileSource> source) : mSource(std::move(source)) {}
+
+void SharedFileStateResidencyDataProvider::addEntity(uint32_t id, const std::string &header,
+        const std::vector<StateResidencyConfig> &configs) {
+    Entity entity = {.id = id, .header = header};
+    for (const auto &config : configs) {
+        State state = {.name = config.name, .header = config.header};
+        if (config.entryCountSupported) {
+            state.fields.push_back({config.entryCountPrefix, Target::ENTRY_COUNT,
+                                    config.entryCountTransform});
+        }
+        if (config.totalTimeSupported) {
+            state.fields.push_back({config.totalTimePrefix, Target::TOTAL_TIME,
+                                    config.totalTimeTransform});
+        }
+        if (config.lastEntrySupported) {
+            state.fields.push_back({config.lastEntryPrefix, Target::LAST_ENTRY,
+                                    config.lastEntryTransform});
+        }
+        entity.states.push_back(std::move(state));
+    }
+    mEntities.push_back(std::move(entity));
+}
+
+void SharedFileStateResidencyDataProvider::addEntity(uint32_t id,
+        const std::vector<StateResidencyConfig> &configs) {
+    addEntity(id, "", configs);
+}
+
+bool SharedFileStateResidencyDataProvider::getResults(
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
+    std::shared_ptr<const FileSnapshot> snapshot = mSource->get();
+    if (!snapshot) {
+        return false;
+    }
+    const std::vector<std::string_view> &lines = snapshot->lines;
+
+    for (const auto &entity : mEntities) {
+        size_t start = 0;
+        if (!entity.header.empty()) {
+            start = findLine(lines, 0, lines.size(), entity.header);
+            if (start == lines.size()) {
+                LOG(ERROR) << __func__ << ":Failed to find " << entity.header << " in "
+                           << mSource->path();
+                return false;
+            }
+        }
+
+        PowerEntityStateResidencyResult result = {.powerEntityId = entity.id};
+        result.stateResidencyData.resize(entity.states.size());
+        for (uint32_t i = 0; i < entity.states.size(); i++) {
+            const State &state = entity.states[i];
+            auto &data = result.stateResidencyData[i];
+            data = {.powerEntityStateId = i};
+
+            size_t stateStart = start;
+            if (!state.header.empty()) {
+                stateStart = findLine(lines, start, lines.size(), state.header);
+                if (stateStart == lines.size()) {
+                    LOG(ERROR) << __func__ << ":Failed to find state header " << state.header
+                               << " in " << mSource->path();
+                    return false;
+                }
+            }
+
+            for (const auto &field : state.fields) {
+                size_t line = findLine(lines, stateStart, lines.size(), field.prefix);
+                uint64_t value;
+                if (line == lines.size() ||
+                        !parseValue(lines[line], field.prefix.size(), &value)) {
+                    LOG(ERROR) << __func__ << ":Failed to parse " << field.prefix << " in "
+                               << mSource->path();
+                    return false;
+                }
+                switch (field.target) {
+                    case Target::ENTRY_COUNT:
+                        data.totalStateEntryCount = field.transform(value);
+                        break;
+                    case Target::TOTAL_TIME:
+                        data.totalTimeInStateMs = field.transform(value);
+                        break;
+                    case Target::LAST_ENTRY:
+                        data.lastEntryTimestampMs = field.transform(value);
+                        break;
+                }
+            }
+        }
+        results.emplace(entity.id, result);
+    }
+    return true;
+}
+
+std::vector<PowerEntityStateSpace> SharedFileStateResidencyDataProvider::getStateSpaces() {
+    std::vector<PowerEntityStateSpace> stateSpaces;
+
+    for (const auto &entity : mEntities) {
+        PowerEntityStateSpace space = {.powerEntityId = entity.id};
+        space.states.resize(entity.states.size());
+        for (uint32_t i = 0; i < entity.states.size(); i++) {
+            space.states[i] = {.powerEntityStateId = i,
+                               .powerEntityStateName = entity.states[i].name};
+        }
+        stateSpaces.push_back(space);
+    }
+    return stateSpaces;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_SHAREDFILESTATERESIDENCYDATAPROVIDER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_SHAREDFILESTATERESIDENCYDATAPROVIDER_H
+
+#include <pixelpowerstats/GenericStateResidencyDataProvider.h>
+#include <pixelpowerstats/PowerStats.h>
+
+#include <functional>
+
+#include "SharedFileSource.h"
+
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::google::pixel::powerstats::StateResidencyConfig;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Same configuration and matching rules as GenericStateResidencyDataProvider,
+ * but the file comes from a SharedFileSource, so several providers on one
+ * file share its reads. Each entity is looked up from the top of the file,
+ * so entities do not have to be added in file order. The configs are
+ * compiled into prefix lookups when added, and the snapshot is already split
+ * into lines, so a query only compares line prefixes.
+ */
+class SharedFileStateResidencyDataProvider : public IStateResidencyDataProvider {
+  public:
+    SharedFileStateResidencyDataProvider(std::shared_ptr<SharedFileSource> source);
+    ~SharedFileStateResidencyDataProvider() = default;
+    void addEntity(uint32_t id, const std::string &header,
+                   const std::vector<StateResidencyConfig> &configs);
+    void addEntity(uint32_t id, const std::vector<StateResidencyConfig> &configs);
+    bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult>
+            &results) override;
+    std::vector<PowerEntityStateSpace> getStateSpaces() override;
+
+  private:
+    enum class Target { ENTRY_COUNT, TOTAL_TIME, LAST_ENTRY };
+    struct Field {
+        std::string prefix;
+        Target target;
+        std::function<uint64_t(uint64_t)> transform;
+    };
+    struct State {
+        std::string name;
+        std::string header;  // empty if the state has none
+        std::vector<Field> fields;
+    };
+    struct Entity {
+        uint32_t id;
+        std::string header;  // empty if the entity has none
+        std::vector<State> states;
+    };
+
+    const std::shared_ptr<SharedFileSource> mSource;
+    std::vector<Entity> mEntities;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_SHAREDFILESTATERESIDENCYDATAPROVIDER_H
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "timedstateresidency"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include "TimedStateResidencyDataProvider.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static const uint64_t kFirstBucketUs = 125;
+
+TimedStateResidencyDataProvider::TimedStateResidencyDataProvider(
+        const std::string &name, sp<IStateResidencyDataProvider> provider,
+        std::chrono::microseconds budget)
+    : mName(name), mProvider(std::move(provider)), mBudget(budget), mCalls(0), mErrors(0),
+      mOverBudget(0), mLastUs(0), mMaxUs(0) {
+    for (auto &bucket : mHistogram) {
+        bucket = 0;
+    }
+}
+
+bool TimedStateResidencyDataProvider::getResults(
+        std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
+    auto begin = std::chrono::steady_clock::now();
+    bool ok = mProvider->getResults(results);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin);
+    uint64_t us = elapsed.count();
+
+    size_t bucket = 0;
+    while (bucket < kBuckets - 1 && us >= kFirstBucketUs << bucket) {
+        bucket++;
+    }
+    mHistogram[bucket]++;
+    mCalls++;
+    mLastUs = us;
+    uint64_t max = mMaxUs.load(std::memory_order_relaxed);
+    while (us > max && !mMaxUs.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+
+    if (!ok) {
+        mErrors++;
+    }
+    if (elapsed > mBudget) {
+        // Log the 1st, 2nd, 4th, ... overrun so a persistently slow node
+        // doesn't flood the log.
+        uint64_t overruns = ++mOverBudget;
+        if ((overruns & (overruns - 1)) == 0) {
+            LOG(WARNING) << __func__ << ":" << mName << " took " << us << "us, budget "
+                         << mBudget.count() << "us (" << overruns << " overruns)";
+        }
+    }
+    return ok;
+}
+
+std::vector<PowerEntityStateSpace> TimedStateResidencyDataProvider::getStateSpaces() {
+    return mProvider->getStateSpaces();
+}
+
+std::string TimedStateResidencyDataProvider::dumpHeader() {
+    std::string out = android::base::StringPrintf("%-8s %8s %6s %6s %8s %8s  ", "Provider",
+                                                  "Calls", "Errors", "Slow", "Last(us)",
+                                                  "Max(us)");
+    for (size_t i = 0; i < kBuckets - 1; i++) {
+        android::base::StringAppendF(&out, " <%g", (kFirstBucketUs << i) / 1000.0);
+    }
+    out += " more (ms)\n";
+    return out;
+}
+
+std::string TimedStateResidencyDataProvider::dump() const {
+    uint64_t overBudget = mOverBudget;
+    std::string out = android::base::StringPrintf("%-8s %8" PRIu64 " %6" PRIu64 " %6" PRIu64
+                                                  " %8" PRIu64 " %8" PRIu64 "  ",
+                                                  mName.c_str(), mCalls.load(), mErrors.load(),
+                                                  overBudget, mLastUs.load(), mMaxUs.load());
+    for (const auto &bucket : mHistogram) {
+        android::base::StringAppendF(&out, " %" PRIu64, bucket.load());
+    }
+    if (overBudget) {
+        android::base::StringAppendF(&out, "  OVER BUDGET (%" PRId64 "us)",
+                                     static_cast<int64_t>(mBudget.count()));
+    }
+    out += "\n";
+    return out;
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_TIMEDSTATERESIDENCYDATAPROVIDER_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_TIMEDSTATERESIDENCYDATAPROVIDER_H
+
+#include <pixelpowerstats/PowerStats.h>
+
+#include <atomic>
+#include <chrono>
+
+using android::hardware::google::pixel::powerstats::IStateResidencyDataProvider;
+using android::hardware::power::stats::V1_0::PowerEntityStateResidencyResult;
+using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * Wraps a provider and times each getResults() call, so a slow debugfs node
+ * can be told apart from the rest of a power.stats call. Calls slower than
+ * the budget are counted and logged; failed calls are counted separately.
+ */
+class TimedStateResidencyDataProvider : public IStateResidencyDataProvider {
+  public:
+    // Bucket i counts calls under 125us << i; the last bucket is open ended.
+    static constexpr size_t kBuckets = 12;
+
+    TimedStateResidencyDataProvider(const std::string &name,
+                                    sp<IStateResidencyDataProvider> provider,
+                                    std::chrono::microseconds budget);
+    bool getResults(std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results)
+            override;
+    std::vector<PowerEntityStateSpace> getStateSpaces() override;
+
+    const std::string &name() const { return mName; }
+    // One line of the table printed by dumpHeader().
+    std::string dump() const;
+    static std::string dumpHeader();
+
+  private:
+    const std::string mName;
+    const sp<IStateResidencyDataProvider> mProvider;
+    const std::chrono::microseconds mBudget;
+
+    std::atomic<uint64_t> mCalls;
+    std::atomic<uint64_t> mErrors;
+    std::atomic<uint64_t> mOverBudget;
+    std::atomic<uint64_t> mLastUs;
+    std::atomic<uint64_t> mMaxUs;
+    std::atomic<uint64_t> mHistogram[kBuckets];
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_TIMEDSTATERESIDENCYDATAPROVIDER_H
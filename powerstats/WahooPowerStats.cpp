@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "android.hardware.power.stats@1.0-service.pixel"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include "WahooPowerStats.h"
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+static uint64_t bootTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+// Per provider getResults() budget; slower calls are flagged in the dump.
+static const char kProviderBudgetProp[] = "persist.vendor.powerstats.provider_budget_ms";
+static const uint32_t kDefaultProviderBudgetMs = 10;
+
+// Deadline for a whole residency query; providers that miss it are answered
+// from their previous results.
+static const char kCollectionDeadlineProp[] = "persist.vendor.powerstats.deadline_ms";
+static const uint32_t kDefaultCollectionDeadlineMs = 100;
+static const size_t kCollectionWorkers = 4;
+
+WahooPowerStats::WahooPowerStats()
+    : mProviderBudget(std::chrono::milliseconds(android::base::GetUintProperty<uint32_t>(
+              kProviderBudgetProp, kDefaultProviderBudgetMs))),
+      mCollector(new ParallelStateResidencyDataProvider(kCollectionWorkers,
+              std::chrono::milliseconds(android::base::GetUintProperty<uint32_t>(
+                      kCollectionDeadlineProp, kDefaultCollectionDeadlineMs)))),
+      mStreamer(new PowerStatsStreamer(mCollector)) {}
+
+uint32_t WahooPowerStats::addPowerEntity(const std::string &name, PowerEntityType type) {
+    uint32_t id = PowerStats::addPowerEntity(name, type);
+    mEntityNames[id] = name;
+    mHistory.setEntityName(id, name);
+    return id;
+}
+
+void WahooPowerStats::addStateResidencyDataProvider(sp<IStateResidencyDataProvider> p) {
+    registerProvider(p, std::to_string(mProviders.size()), true);
+}
+
+void WahooPowerStats::addStateResidencyDataProvider(sp<IStateResidencyDataProvider> p,
+                                                    const std::string &name, bool history) {
+    sp<TimedStateResidencyDataProvider> timed =
+            new TimedStateResidencyDataProvider(name, p, mProviderBudget);
+    mTimedProviders.push_back(timed);
+    registerProvider(timed, name, history);
+}
+
+void WahooPowerStats::registerProvider(sp<IStateResidencyDataProvider> p,
+                                       const std::string &name, bool history) {
+    PowerStats::addStateResidencyDataProvider(p);
+    if (history) {
+        mHistory.addStateResidencyDataProvider(p);
+    }
+    mCollector->addProvider(name, p);
+    mProviders.push_back(p);
+}
+
+Return<void> WahooPowerStats::getPowerEntityStateResidencyData(
+        const hidl_vec<uint32_t> &powerEntityIds, getPowerEntityStateResidencyData_cb _hidl_cb) {
+    for (uint32_t id : powerEntityIds) {
+        if (mEntityNames.find(id) == mEntityNames.end()) {
+            _hidl_cb({}, Status::INVALID_INPUT);
+            return Void();
+        }
+    }
+
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+    bool ok = powerEntityIds.size() == 0
+            ? mCollector->getResults(results)
+            : mCollector->getResults(results, powerEntityIds);
+
+    if (results.empty()) {
+        _hidl_cb({}, ok ? Status::NOT_SUPPORTED : Status::FILESYSTEM_ERROR);
+        return Void();
+    }
+
+    std::vector<PowerEntityStateResidencyResult> out;
+    if (powerEntityIds.size() == 0) {
+        for (auto &result : results) {
+            out.push_back(std::move(result.second));
+        }
+    } else {
+        // Like PowerStats, return what is available when a provider failed.
+        for (uint32_t id : powerEntityIds) {
+            auto result = results.find(id);
+            if (result == results.end()) {
+                ok = false;
+                continue;
+            }
+            out.push_back(result->second);
+        }
+    }
+    _hidl_cb(out, ok ? Status::SUCCESS : Status::FILESYSTEM_ERROR);
+    return Void();
+}
+
+bool WahooPowerStats::loadEnergyModel(const std::string &path) {
+    std::vector<PowerEntityStateSpace> stateSpaces;
+    for (const auto &provider : mProviders) {
+        std::vector<PowerEntityStateSpace> spaces = provider->getStateSpaces();
+        stateSpaces.insert(stateSpaces.end(), spaces.begin(), spaces.end());
+    }
+
+    std::shared_ptr<const EnergyModel> model = EnergyModel::load(path, mEntityNames, stateSpaces);
+    if (!model) {
+        return false;
+    }
+    mEnergyModel = model;
+    mStreamer->setEnergyModel(model);
+    return true;
+}
+
+bool WahooPowerStats::startHistory(uint32_t intervalMs, uint64_t retentionMs) {
+    return mHistory.start(intervalMs, retentionMs);
+}
+
+void WahooPowerStats::dumpLatency(int fd) {
+    std::string out = TimedStateResidencyDataProvider::dumpHeader();
+    for (const auto &provider : mTimedProviders) {
+        out += provider->dump();
+    }
+    android::base::StringAppendF(&out, "budget %" PRId64 " us\n",
+                                 static_cast<int64_t>(mProviderBudget.count()));
+    android::base::WriteStringToFd(out, fd);
+}
+
+void WahooPowerStats::dumpEnergy(int fd) {
+    if (!mEnergyModel) {
+        android::base::WriteStringToFd("no energy model loaded\n", fd);
+        return;
+    }
+
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> results;
+    mCollector->getResults(results);
+    uint64_t nowMs = bootTimeMs();
+
+    std::lock_guard<std::mutex> lock(mEnergyLock);
+    std::string out = android::base::StringPrintf("%-12s %14s %10s %14s %10s\n", "Entity",
+            "Interval(mJ)", "Avg(mW)", "Boot(mJ)", "Avg(mW)");
+    for (uint32_t id : mEnergyModel->entityIds()) {
+        auto result = results.find(id);
+        if (result == results.end()) {
+            continue;
+        }
+        const auto &data = result->second.stateResidencyData;
+        EntityEnergy boot = mEnergyModel->estimate(id, data, nowMs);
+
+        // Since the previous dump; the first dump covers the time since boot.
+        EntityEnergy interval = boot;
+        auto prev = mEnergyPrev.find(id);
+        if (prev != mEnergyPrev.end()) {
+            hidl_vec<PowerEntityStateResidencyData> deltas(data);
+            for (auto &delta : deltas) {
+                for (const auto &p : prev->second.stateResidencyData) {
+                    if (p.powerEntityStateId == delta.powerEntityStateId) {
+                        delta.totalTimeInStateMs = delta.totalTimeInStateMs >= p.totalTimeInStateMs
+                                ? delta.totalTimeInStateMs - p.totalTimeInStateMs : 0;
+                        break;
+                    }
+                }
+            }
+            interval = mEnergyModel->estimate(id, deltas, nowMs - mEnergyPrevMs);
+        }
+
+        android::base::StringAppendF(&out, "%-12s %14.1f %10.1f %14.1f %10.1f\n",
+                mEntityNames[id].c_str(), interval.energyUj / 1000.0,
+                interval.intervalMs ? 1.0 * interval.energyUj / interval.intervalMs : 0.0,
+                boot.energyUj / 1000.0,
+                boot.intervalMs ? 1.0 * boot.energyUj / boot.intervalMs : 0.0);
+    }
+    android::base::StringAppendF(&out, "interval %" PRIu64 " ms\n",
+                                 nowMs - (mEnergyPrev.empty() ? 0 : mEnergyPrevMs));
+    mEnergyPrev = std::move(results);
+    mEnergyPrevMs = nowMs;
+    android::base::WriteStringToFd(out, fd);
+}
+
+Return<void> WahooPowerStats::debug(const hidl_handle &handle,
+                                    const hidl_vec<hidl_string> &args) {
+    if (handle == nullptr || handle->numFds < 1) {
+        return Void();
+    }
+    int fd = handle->data[0];
+
+    if (args.size() == 0) {
+        PowerStats::debug(handle, args);
+        android::base::WriteStringToFd("\nProvider latency:\n", fd);
+        dumpLatency(fd);
+        android::base::WriteStringToFd("\nProvider collection:\n", fd);
+        mCollector->dump(fd);
+        android::base::WriteStringToFd("\nEnergy estimate:\n", fd);
+        dumpEnergy(fd);
+        android::base::WriteStringToFd("\nStreaming:\n", fd);
+        mStreamer->dumpStatus(fd);
+        android::base::WriteStringToFd("\nHistory:\n", fd);
+        mHistory.dumpStatus(fd);
+    } else if (args[0] == "--stream-status") {
+        mStreamer->dumpStatus(fd);
+    } else if (args[0] == "--history") {
+        mHistory.dump(fd);
+    } else {
+        android::base::WriteStringToFd("Unknown option " + std::string(args[0]) + "\n", fd);
+    }
+
+    fsync(fd);
+    return Void();
+}
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
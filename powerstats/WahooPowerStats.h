@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEVICE_GOOGLE_WAHOO_POWERSTATS_WAHOOPOWERSTATS_H
+#define DEVICE_GOOGLE_WAHOO_POWERSTATS_WAHOOPOWERSTATS_H
+
+#include <pixelpowerstats/PowerStats.h>
+
+#include "ParallelStateResidencyDataProvider.h"
+#include "PowerStatsStreamer.h"
+#include "ResidencyHistoryRecorder.h"
+#include "TimedStateResidencyDataProvider.h"
+
+using android::hardware::hidl_handle;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Return;
+using android::hardware::Void;
+using android::hardware::power::stats::V1_0::PowerEntityType;
+using android::hardware::power::stats::V1_0::Status;
+using android::hardware::power::stats::V1_0::implementation::PowerStats;
+
+namespace android {
+namespace device {
+namespace google {
+namespace wahoo {
+namespace powerstats {
+
+/*
+ * PowerStats with the wahoo additions reachable through debug():
+ *
+ *   lshal debug android.hardware.power.stats@1.0::IPowerStats/default [option]
+ *     (none)                 default dump followed by provider latency and
+ *                            collection state, the energy estimate, the
+ *                            streaming status and the history status
+ *     --stream-status        streaming state and queue counters
+ *     --history              residency history for residency_history_reader
+ *
+ * Residency deltas are streamed to clients of IPowerStatsStream, served by
+ * streamer().
+ */
+class WahooPowerStats : public PowerStats {
+  public:
+    WahooPowerStats();
+    uint32_t addPowerEntity(const std::string &name, PowerEntityType type);
+    void addStateResidencyDataProvider(sp<IStateResidencyDataProvider> p);
+    // Adds |p| behind a TimedStateResidencyDataProvider reported as |name|.
+    // |history| includes it in the periodic residency history.
+    void addStateResidencyDataProvider(sp<IStateResidencyDataProvider> p,
+                                       const std::string &name, bool history = true);
+    // Call once all entities and providers have been added.
+    bool loadEnergyModel(const std::string &path);
+    bool startHistory(uint32_t intervalMs, uint64_t retentionMs);
+    sp<PowerStatsStreamer> streamer() { return mStreamer; }
+
+    // Methods from ::android::hardware::power::stats::V1_0::IPowerStats follow.
+    // Residency is collected from all providers in parallel, see
+    // ParallelStateResidencyDataProvider.
+    Return<void> getPowerEntityStateResidencyData(
+            const hidl_vec<uint32_t> &powerEntityIds,
+            getPowerEntityStateResidencyData_cb _hidl_cb) override;
+
+    // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle &fd, const hidl_vec<hidl_string> &args) override;
+
+  private:
+    void registerProvider(sp<IStateResidencyDataProvider> p, const std::string &name,
+                          bool history);
+    void dumpLatency(int fd);
+    void dumpEnergy(int fd);
+
+    ResidencyHistoryRecorder mHistory;
+    std::unordered_map<uint32_t, std::string> mEntityNames;
+    std::vector<sp<IStateResidencyDataProvider>> mProviders;
+    std::vector<sp<TimedStateResidencyDataProvider>> mTimedProviders;
+    std::chrono::microseconds mProviderBudget;
+    sp<ParallelStateResidencyDataProvider> mCollector;
+    sp<PowerStatsStreamer> mStreamer;  // samples mCollector
+    std::shared_ptr<const EnergyModel> mEnergyModel;
+
+    // Residency at the previous dump, for the per-interval estimate.
+    std::mutex mEnergyLock;
+    std::unordered_map<uint32_t, PowerEntityStateResidencyResult> mEnergyPrev;
+    uint64_t mEnergyPrevMs = 0;
+};
+
+}  // namespace powerstats
+}  // namespace wahoo
+}  // namespace google
+}  // namespace device
+}  // namespace android
+
+#endif  // DEVICE_GOOGLE_WAHOO_POWERSTATS_WAHOOPOWERSTATS_H
@@ -24,10 +24,9 @@
 #include <hidl/HidlTransportSupport.h>
 
 #include <pixelpowerstats/AidlStateResidencyDataProvider.h>
-#include <pixelpowerstats/GenericStateResidencyDataProvider.h>
 #include <pixelpowerstats/PowerStats.h>
-#include <pixelpowerstats/WlanStateResidencyDataProvider.h>
-#include "EaselStateResidencyDataProvider.h"
+#include "PowerStatsConfig.h"
+#include "WahooPowerStats.h"
 
 using android::OK;
 using android::sp;
@@ -42,91 +41,32 @@ using android::hardware::power::stats::V1_0::IPowerStats;
 using android::hardware::power::stats::V1_0::PowerEntityInfo;
 using android::hardware::power::stats::V1_0::PowerEntityStateSpace;
 using android::hardware::power::stats::V1_0::PowerEntityType;
-using android::hardware::power::stats::V1_0::implementation::PowerStats;
 
 // Pixel specific
 using android::hardware::google::pixel::powerstats::AidlStateResidencyDataProvider;
-using android::hardware::google::pixel::powerstats::GenericStateResidencyDataProvider;
-using android::hardware::google::pixel::powerstats::PowerEntityConfig;
-using android::hardware::google::pixel::powerstats::StateResidencyConfig;
-using android::hardware::google::pixel::powerstats::WlanStateResidencyDataProvider;
 
 // Wahoo specific
-using android::device::google::wahoo::powerstats::EaselStateResidencyDataProvider;
+using android::device::google::wahoo::powerstats::PowerStatsConfig;
+using android::device::google::wahoo::powerstats::WahooPowerStats;
 
-int main(int /* argc */, char ** /* argv */) {
+static const char kDefaultConfigPath[] = "/vendor/etc/powerstats_config.json";
+
+int main(int argc, char **argv) {
     ALOGI("power.stats service 1.0 is starting.");
 
     bool isDebuggable = android::base::GetBoolProperty("ro.debuggable", false);
 
-    PowerStats *service = new PowerStats();
-
-    if (isDebuggable) {
-        // Add power entities related to rpmh
-        const uint64_t RPM_CLK = 19200;  // RPM runs at 19.2Mhz. Divide by 19200 for msec
-        std::function<uint64_t(uint64_t)> rpmConvertToMs = [](uint64_t a) { return a / RPM_CLK; };
-        std::vector<StateResidencyConfig> rpmStateResidencyConfigs = {
-            {.name = "XO_shutdown",
-             .entryCountSupported = true,
-             .entryCountPrefix = "XO Count:",
-             .totalTimeSupported = true,
-             .totalTimePrefix = "Accumulated XO duration:",
-             .totalTimeTransform = rpmConvertToMs,
-             .lastEntrySupported = false}};
-
-        sp<GenericStateResidencyDataProvider> rpmSdp =
-                new GenericStateResidencyDataProvider("/d/system_stats");
-
-        uint32_t apssId = service->addPowerEntity("APSS", PowerEntityType::SUBSYSTEM);
-        rpmSdp->addEntity(apssId, PowerEntityConfig("APSS", rpmStateResidencyConfigs));
-
-        uint32_t mpssId = service->addPowerEntity("MPSS", PowerEntityType::SUBSYSTEM);
-        rpmSdp->addEntity(mpssId, PowerEntityConfig("MPSS", rpmStateResidencyConfigs));
-
-        uint32_t adspId = service->addPowerEntity("ADSP", PowerEntityType::SUBSYSTEM);
-        rpmSdp->addEntity(adspId, PowerEntityConfig("ADSP", rpmStateResidencyConfigs));
-
-        uint32_t slpiId = service->addPowerEntity("SLPI", PowerEntityType::SUBSYSTEM);
-        rpmSdp->addEntity(slpiId, PowerEntityConfig("SLPI", rpmStateResidencyConfigs));
-
-        service->addStateResidencyDataProvider(rpmSdp);
-
-        // Add SoC power entity
-        std::vector<StateResidencyConfig> socStateResidencyConfigs = {
-            {.name = "XO_shutdown",
-             .header = "RPM Mode:vlow",
-             .entryCountSupported = true,
-             .entryCountPrefix = "count:",
-             .totalTimeSupported = true,
-             .totalTimePrefix = "actual last sleep(msec):",
-             .lastEntrySupported = false},
-            {.name = "VMIN",
-             .header = "RPM Mode:vmin",
-             .entryCountSupported = true,
-             .entryCountPrefix = "count:",
-             .totalTimeSupported = true,
-             .totalTimePrefix = "actual last sleep(msec):",
-             .lastEntrySupported = false}};
-
-         sp<GenericStateResidencyDataProvider> socSdp =
-                new GenericStateResidencyDataProvider("/d/system_stats");
-
-        uint32_t socId = service->addPowerEntity("SoC", PowerEntityType::POWER_DOMAIN);
-        socSdp->addEntity(socId, PowerEntityConfig(socStateResidencyConfigs));
-
-        service->addStateResidencyDataProvider(socSdp);
-
-        // Add WLAN power entity
-        uint32_t wlanId = service->addPowerEntity("WLAN", PowerEntityType::SUBSYSTEM);
-        sp<WlanStateResidencyDataProvider> wlanSdp =
-                new WlanStateResidencyDataProvider(wlanId, "/d/wlan0/power_stats");
-        service->addStateResidencyDataProvider(wlanSdp);
-    }
+    WahooPowerStats *service = new WahooPowerStats();
 
-    // Add Easel power entity
-    uint32_t easelId = service->addPowerEntity("Easel", PowerEntityType::SUBSYSTEM);
-    sp<EaselStateResidencyDataProvider> easelSdp = new EaselStateResidencyDataProvider(easelId);
-    service->addStateResidencyDataProvider(easelSdp);
+    // Entities and their providers come from the vendor config, or from the
+    // config given as the only argument when running against captured nodes.
+    // Without a valid config only the AIDL entities are reported.
+    auto config = PowerStatsConfig::load(argc > 1 ? argv[1] : kDefaultConfigPath);
+    if (config) {
+        config->apply(service, isDebuggable);
+    } else {
+        ALOGE("Invalid power.stats config, no built-in power entities");
+    }
 
     // Add Power Entities that require the Aidl data provider
     sp<AidlStateResidencyDataProvider> aidlSdp = new AidlStateResidencyDataProvider();
@@ -145,7 +85,15 @@ int main(int /* argc */, char ** /* argv */) {
     sp<android::ProcessState> ps{android::ProcessState::self()};  // Create non-HW binder threadpool
     ps->startThreadPool();
 
-    service->addStateResidencyDataProvider(aidlSdp);
+    service->addStateResidencyDataProvider(aidlSdp, "AIDL");
+
+    // Coefficients for the energy estimate in the debug dump and the stream.
+    if (!service->loadEnergyModel("/vendor/etc/powerstats_energy_model.json")) {
+        ALOGW("No energy model, reporting residency only");
+    }
+
+    // One sample a minute, kept for a day.
+    service->startHistory(60 * 1000, 24 * 3600 * 1000ULL);
 
     // Configure the threadpool
     configureRpcThreadpool(1, true /*callerWillJoin*/);
@@ -156,6 +104,12 @@ int main(int /* argc */, char ** /* argv */) {
         return 1;
     }
 
+    status = service->streamer()->registerAsService();
+    if (status != OK) {
+        ALOGE("Could not register service for power.stats stream Iface (%d), exiting.", status);
+        return 1;
+    }
+
     ALOGI("power.stats service is ready");
     joinRpcThreadpool();
 